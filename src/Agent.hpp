@@ -23,6 +23,10 @@
 #ifndef MINE_SWEEPER_CPP_SHELL_AGENT_HPP
 #define MINE_SWEEPER_CPP_SHELL_AGENT_HPP
 
+#include <atomic>
+#include <random>
+#include <vector>
+
 class Agent {
 
 public:
@@ -49,10 +53,80 @@ public:
 
         };
 
+        virtual ~Agent ( ) { }
+
+        // Start a new game with the same agent, as if it had just been
+        // constructed with these arguments. Agents with state to clear
+        // override it; the World calls it on pooled agents.
+        virtual void reset ( int _rowDimension, int _colDimension, int _totalMines, int _agentX, int _agentY )
+        {
+            rowDimension = _rowDimension;
+            colDimension = _colDimension;
+            totalMines   = _totalMines;
+            agentX       = _agentX;
+            agentY       = _agentY;
+        }
+
         virtual Action getAction
                 (
                     int number
                 ) = 0;
+
+        // A tile the last action revealed; coordinates as in Action
+        struct Reveal{
+            int             x;
+            int             y;
+            int             number;
+        };
+
+        // Batch mode: append to actions (empty on entry) every move the agent
+        // can commit to before it sees another percept. The World applies them
+        // in order, each counting as a move, stops at the first one that ends
+        // the game and returns all their reveals in the next call. Only used if
+        // acceptsBatches(); the default is the single getAction move.
+        virtual bool acceptsBatches ( ) const { return false; }
+        virtual void getActions
+                (
+                    const std::vector<Reveal>& reveals,
+                    std::vector<Action>& actions
+                )
+        {
+            actions.push_back( getAction( reveals ) );
+        }
+
+        // Extended percept for the World's cascade mode: every tile the last
+        // action revealed, the tile the agent uncovered first and then the
+        // zero region flooded from it. Empty after FLAG and UNFLAG. The World
+        // only uses it if acceptsReveals(); by default the agent just sees
+        // the number of its own tile.
+        virtual Action getAction
+                (
+                    const std::vector<Reveal>& reveals
+                )
+        {
+            return getAction( reveals.empty() ? -1 : reveals.front().number );
+        }
+        virtual bool acceptsReveals ( ) const { return false; }
+
+        // Moves of this game the agent made without knowing them safe (guessed
+        // uncovers, likeliest-mine flags); -1 if the agent does not count them.
+        virtual int guesses ( ) const { return -1; }
+
+        // Time budgets: the runner's stop flag for the current game, or nullptr.
+        // Once it is set the game is over budget; agents with long searches
+        // poll it and answer at once with what they have.
+        void watch ( const std::atomic<bool>* flag ) { stop = flag; }
+
+        // Every agent draws its random moves from its own engine, seeded
+        // by the World, so a game replays exactly from the World's seed.
+        void seed ( unsigned long s ) { engine.seed( s ); }
+
+protected:
+        std::mt19937 engine;
+        const std::atomic<bool>* stop = nullptr;
+
+        // Random int in the range [0, limit)
+        int randomInt ( int limit ) { return std::uniform_int_distribution<int>( 0, limit - 1 )( engine ); }
         };
 
 #endif //MINE_SWEEPER_CPP_SHELL_AGENT_HPP
@@ -0,0 +1,78 @@
+// ======================================================================
+// FILE:        Arena.hpp
+//
+// DESCRIPTION: This file contains the arena that per-game state comes
+//              from in long runs (-f folders and -g generated worlds).
+//              Allocation is a pointer bump; reset() releases everything
+//              at once between worlds and keeps the memory, so after the
+//              first few worlds a run allocates nothing from the heap for
+//              its boards and agents and its footprint stays flat.
+//
+// NOTES:       - Nothing is destroyed by reset(): owners call destructors
+//                on what they constructed in the arena before it is reset.
+//
+//              - An arena serves one World at a time; it is not shared
+//                between threads.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_ARENA_HPP
+#define MINE_SWEEPER_CPP_SHELL_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class Arena
+{
+public:
+    Arena ( ) : used( 0 ), size( 0 ), retired( 0 ) {}
+
+    void* allocate ( std::size_t bytes, std::size_t align = alignof(std::max_align_t) )
+    {
+        void* p = blocks.empty() ? nullptr : blocks.back().get() + used;
+        std::size_t space = size - used;
+        if ( p == nullptr || std::align( align, bytes, p, space ) == nullptr )
+        {
+            // Overflow block; reset() folds the blocks into one big enough for them all
+            std::size_t grown = 2 * size > bytes + align ? 2 * size : bytes + align;
+            retired += size;
+            blocks.emplace_back( new char[grown] );
+            size = grown;
+            p = blocks.back().get();
+            space = size;
+            std::align( align, bytes, p, space );
+        }
+        used = size - space + bytes;
+        return p;
+    }
+
+    template <class T, class... Args>
+    T* make ( Args&&... args )
+    {
+        return new ( allocate( sizeof(T), alignof(T) ) ) T( std::forward<Args>( args )... );
+    }
+
+    // Release everything allocated since the last reset
+    void reset ( )
+    {
+        if ( blocks.size() > 1 )
+        {
+            std::size_t total = retired + size;
+            blocks.clear();
+            blocks.emplace_back( new char[total] );
+            size = total;
+        }
+        retired = 0;
+        used = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t used;       // bytes used in the last block
+    std::size_t size;       // size of the last block
+    std::size_t retired;    // sizes of the blocks before the last one
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_ARENA_HPP
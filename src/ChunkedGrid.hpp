@@ -0,0 +1,111 @@
+// ======================================================================
+// FILE:        ChunkedGrid.hpp
+//
+// DESCRIPTION: This file contains the sparse grid behind huge boards (see
+//              isHugeBoard in Geometry.hpp). The grid is cut into fixed
+//              64x64 chunks that are only allocated when a tile in them
+//              is first written, so memory follows the part of the board
+//              actually played rather than its area. Reads of a chunk
+//              never written return the fill value without allocating.
+//
+// NOTES:       - The chunk directory is laid out in Z-order (Morton order
+//                of the chunk coordinates), so chunks that are close on
+//                the board are close in the directory.
+//
+//              - Inside a chunk tiles are [x][y], like the World's board.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_CHUNKEDGRID_HPP
+#define MINE_SWEEPER_CPP_SHELL_CHUNKEDGRID_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+template <class T>
+class ChunkedGrid
+{
+public:
+    static const int bits = 6;
+    static const int side = 1 << bits;      // tiles per chunk edge
+    static const int mask = side - 1;
+
+    ChunkedGrid ( ) : fill( T() ), chunkCols( 0 ), chunkRows( 0 ), chunksInUse( 0 ) {}
+
+    // Size the directory for a cols x rows grid and drop every chunk
+    void assign ( int cols, int rows, T _fill )
+    {
+        fill = _fill;
+        chunkCols = ( cols + mask ) >> bits;
+        chunkRows = ( rows + mask ) >> bits;
+        std::uint64_t span = 1;
+        while ( span < (std::uint64_t) std::max( chunkCols, chunkRows ) )
+            span <<= 1;
+        directory.clear();
+        directory.resize( span * span );
+        chunksInUse = 0;
+    }
+
+    int     columnsOfChunks ( ) const { return chunkCols; }
+    int     rowsOfChunks    ( ) const { return chunkRows; }
+    long    allocated       ( ) const { return chunksInUse; }
+
+    // The chunk holding chunk coordinates (cx, cy), or nullptr if it was never written
+    T* find ( int cx, int cy ) const
+    {
+        return directory[morton( cx, cy )].get();
+    }
+
+    // Allocate the chunk at (cx, cy), every tile set to the fill value
+    T* create ( int cx, int cy )
+    {
+        std::unique_ptr<T[]>& slot = directory[morton( cx, cy )];
+        slot.reset( new T[side * side] );
+        std::fill( slot.get(), slot.get() + side * side, fill );
+        ++chunksInUse;
+        return slot.get();
+    }
+
+    T get ( int x, int y ) const
+    {
+        const T* chunk = find( x >> bits, y >> bits );
+        return chunk ? chunk[offset( x, y )] : fill;
+    }
+
+    T& at ( int x, int y )
+    {
+        T* chunk = find( x >> bits, y >> bits );
+        if ( !chunk )
+            chunk = create( x >> bits, y >> bits );
+        return chunk[offset( x, y )];
+    }
+
+    static int offset ( int x, int y ) { return ( x & mask ) * side + ( y & mask ); }
+
+private:
+    std::vector<std::unique_ptr<T[]>> directory;
+    T       fill;
+    int     chunkCols;
+    int     chunkRows;
+    long    chunksInUse;
+
+    // Interleave the bits of cx and cy (cx in the even bits)
+    static std::uint64_t spread ( std::uint64_t v )
+    {
+        v &= 0xFFFFFFFF;
+        v = ( v | ( v << 16 ) ) & 0x0000FFFF0000FFFFULL;
+        v = ( v | ( v << 8 ) )  & 0x00FF00FF00FF00FFULL;
+        v = ( v | ( v << 4 ) )  & 0x0F0F0F0F0F0F0F0FULL;
+        v = ( v | ( v << 2 ) )  & 0x3333333333333333ULL;
+        v = ( v | ( v << 1 ) )  & 0x5555555555555555ULL;
+        return v;
+    }
+
+    static std::uint64_t morton ( int cx, int cy )
+    {
+        return spread( cx ) | ( spread( cy ) << 1 );
+    }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_CHUNKEDGRID_HPP
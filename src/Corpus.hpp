@@ -0,0 +1,261 @@
+// ======================================================================
+// FILE:        Corpus.hpp
+//
+// DESCRIPTION: This file contains the packed world corpus: every world of
+//              a folder in one file, memory-mapped and read in place.
+//              A header, then a fixed-size index of one entry per world
+//              (size, start tile, mine count, name and where its mines
+//              are), then the mine maps, one bit per tile. A World is
+//              built from an entry with no parsing and no system call.
+//
+// NOTES:       - Layout, all integers little-endian:
+//
+//                  Header  magic "MSCORPUS", version, count
+//                  Entry   x count, 64 bytes each
+//                  Mines   per world, tile [c][r] in bit c * rows + r
+//                          (the World's board order), padded to 8 bytes
+//
+//              - pack() writes the worlds of a folder in readdir order, so
+//                world n of the corpus is world n of a folder run and gets
+//                the same seed. Start tiles are 1-based as in the text files.
+//
+//              - A Corpus is read-only once open and may be shared by
+//                threads.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_CORPUS_HPP
+#define MINE_SWEEPER_CPP_SHELL_CORPUS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Geometry.hpp"
+
+class Corpus
+{
+public:
+    struct Header
+    {
+        char            magic[8];
+        std::uint32_t   version;
+        std::uint32_t   count;
+    };
+
+    struct Entry
+    {
+        std::uint64_t   offset;         // of the mine map, from the start of the file
+        std::uint32_t   rows;
+        std::uint32_t   cols;
+        std::uint32_t   startX;         // column of the first move, 1-based
+        std::uint32_t   startY;         // row of the first move, 1-based
+        std::uint32_t   mines;
+        char            name[36];       // file name in the folder, 0-terminated (pack() rejects longer ones)
+    };
+
+    static_assert( sizeof( Header ) == 16 && sizeof( Entry ) == 64, "Corpus layout must not depend on padding" );
+
+    // A world of the corpus, pointing into the mapping
+    struct Packed
+    {
+        const Entry*            entry;
+        const unsigned char*    mines;  // rows * cols bits, in whole 8-byte words
+    };
+
+    Corpus ( ) : data( nullptr ), size( 0 ) {}
+    ~Corpus ( ) { close(); }
+    Corpus ( const Corpus& ) = delete;
+    Corpus& operator= ( const Corpus& ) = delete;
+
+    // True if path starts with the corpus magic
+    static bool isCorpus ( const std::string& path )
+    {
+        char magic[sizeof( Header().magic )] = {};
+        std::ifstream file( path, std::ios::binary );
+        return file.read( magic, sizeof magic ) && std::memcmp( magic, corpusMagic(), sizeof magic ) == 0;
+    }
+
+    // Map path and check that the index and every mine map lie within it
+    bool open ( const std::string& path )
+    {
+        close();
+        int fd = ::open( path.c_str(), O_RDONLY );
+        if ( fd < 0 )
+            return false;
+        struct stat info;
+        if ( fstat( fd, &info ) == 0 && (std::size_t) info.st_size >= sizeof( Header ) )
+        {
+            size = info.st_size;
+            void* mapped = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char*>( mapped );
+        }
+        ::close( fd );
+        if ( data && valid() )
+            return true;
+        close();
+        return false;
+    }
+
+    void close ( )
+    {
+        if ( data )
+            munmap( const_cast<unsigned char*>( data ), size );
+        data = nullptr;
+        size = 0;
+    }
+
+    int     count   ( ) const { return header()->count; }
+    Packed  world   ( int n ) const
+    {
+        const Entry* entry = entries() + n;
+        return { entry, data + entry->offset };
+    }
+
+    // Pack the worlds of folder into output; false, with the reason on the console, if a
+    // world cannot be read or is too large for a file world
+    static bool pack ( const std::string& folder, const std::string& output )
+    {
+        DIR* dir = opendir( folder.c_str() );
+        if ( dir == nullptr )
+        {
+            std::cout << "[ERROR] Failed to open directory." << std::endl;
+            return false;
+        }
+
+        std::vector<Entry> index;
+        std::vector<unsigned char> mines;
+        struct dirent* ent;
+        bool ok = true;
+        while ( ok && ( ent = readdir( dir ) ) != NULL )
+        {
+            if ( ent->d_name[0] == '.' )
+                continue;
+            Entry entry = Entry();
+            const std::size_t length = std::strlen( ent->d_name );
+            if ( length >= sizeof entry.name )
+            {
+                std::cout << "[ERROR] Could not pack " << ent->d_name << ": names are limited to "
+                          << sizeof entry.name - 1 << " bytes." << std::endl;
+                ok = false;
+                break;
+            }
+            std::memcpy( entry.name, ent->d_name, length );
+            entry.name[length] = 0;
+            entry.offset = mines.size();
+            ok = readWorld( folder + "/" + ent->d_name, entry, mines );
+            if ( ok )
+                index.push_back( entry );
+            else
+                std::cout << "[ERROR] Could not pack " << ent->d_name << "." << std::endl;
+        }
+        closedir( dir );
+        if ( !ok )
+            return false;
+
+        Header header;
+        std::memcpy( header.magic, corpusMagic(), sizeof header.magic );
+        header.version = corpusVersion;
+        header.count   = index.size();
+        const std::uint64_t base = sizeof( Header ) + index.size() * sizeof( Entry );
+        for ( Entry& entry : index )
+            entry.offset += base;
+
+        std::ofstream file( output, std::ios::binary );
+        file.write( reinterpret_cast<const char*>( &header ), sizeof header );
+        file.write( reinterpret_cast<const char*>( index.data() ), index.size() * sizeof( Entry ) );
+        file.write( reinterpret_cast<const char*>( mines.data() ), mines.size() );
+        if ( !file )
+        {
+            std::cout << "[ERROR] Could not write " << output << "." << std::endl;
+            return false;
+        }
+        std::cout << "Packed " << index.size() << " worlds into " << output << "." << std::endl;
+        return true;
+    }
+
+private:
+    static const char*              corpusMagic     ( ) { return "MSCORPUS"; }
+    static const std::uint32_t      corpusVersion   = 1;
+
+    const unsigned char*    data;
+    std::size_t             size;
+
+    const Header*   header  ( ) const { return reinterpret_cast<const Header*>( data ); }
+    const Entry*    entries ( ) const { return reinterpret_cast<const Entry*>( data + sizeof( Header ) ); }
+
+    static std::uint64_t mapBytes ( std::uint64_t tiles ) { return ( tiles + 63 ) / 64 * 8; }
+
+    bool valid ( ) const
+    {
+        if ( std::memcmp( header()->magic, corpusMagic(), sizeof( Header().magic ) ) != 0 || header()->version != corpusVersion )
+            return false;
+        if ( header()->count > ( size - sizeof( Header ) ) / sizeof( Entry ) )
+            return false;
+        for ( int n = 0; n < count(); ++n )
+        {
+            const Entry& entry = entries()[n];
+            const std::uint64_t tiles = (std::uint64_t) entry.rows * entry.cols;
+            if ( tiles == 0 || tiles > (std::uint64_t) maxBoardTiles || entry.offset > size || mapBytes( tiles ) > size - entry.offset
+                 || entry.name[sizeof entry.name - 1] != 0 || !validStart( entry, data + entry.offset ) )
+                return false;
+        }
+        return true;
+    }
+
+    // The start tile must lie on the board with no mine on or around it, as the World
+    // requires of a first move; checked here so a bad entry fails open() instead of the run
+    static bool validStart ( const Entry& entry, const unsigned char* mines )
+    {
+        if ( entry.startX < 1 || entry.startX > entry.cols || entry.startY < 1 || entry.startY > entry.rows )
+            return false;
+        const long c0 = entry.startX - 1, r0 = entry.startY - 1;
+        for ( long c = c0 - 1; c <= c0 + 1; ++c )
+            for ( long r = r0 - 1; r <= r0 + 1; ++r )
+            {
+                if ( c < 0 || c >= (long) entry.cols || r < 0 || r >= (long) entry.rows )
+                    continue;
+                const long bit = c * entry.rows + r;
+                if ( mines[bit / 8] >> bit % 8 & 1 )
+                    return false;
+            }
+        return true;
+    }
+
+    // Parse a text world (rows cols, startX startY, then the rows top down) into entry and
+    // its mine map, appended to mines
+    static bool readWorld ( const std::string& path, Entry& entry, std::vector<unsigned char>& mines )
+    {
+        std::ifstream file( path );
+        long rows = 0, cols = 0;
+        if ( !( file >> rows >> cols >> entry.startX >> entry.startY ) || rows < 1 || cols < 1 || rows * cols > maxBoardTiles )
+            return false;
+        entry.rows = rows;
+        entry.cols = cols;
+
+        const std::size_t base = mines.size();
+        mines.resize( base + mapBytes( rows * cols ), 0 );
+        for ( long r = rows - 1; r >= 0; --r )
+            for ( long c = 0; c < cols; ++c )
+            {
+                bool mine;
+                if ( !( file >> mine ) )
+                    return false;
+                if ( mine )
+                {
+                    const long bit = c * rows + r;
+                    mines[base + bit / 8] |= 1 << bit % 8;
+                    ++entry.mines;
+                }
+            }
+        return validStart( entry, &mines[base] );
+    }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_CORPUS_HPP
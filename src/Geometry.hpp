@@ -0,0 +1,107 @@
+// ======================================================================
+// FILE:        Geometry.hpp
+//
+// DESCRIPTION: This file contains the board geometries shared by the
+//              World and MyAI. The three tournament sizes (8x8, 16x16
+//              and 16x30, see generateTournament.sh) get compile-time
+//              dimensions so that neighbour loops fold to constant
+//              offsets and bounds; every other size falls back to the
+//              runtime geometry.
+//
+// NOTES:       - Sizes are given as columns x rows, the way the World
+//                indexes its board ([col][row]).
+//
+//              - Padded grids store tile (x, y) at x * stride + y with a
+//                one tile border on every side, so (x, y) is 1-based and
+//                every tile has 8 addressable neighbours.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_GEOMETRY_HPP
+#define MINE_SWEEPER_CPP_SHELL_GEOMETRY_HPP
+
+template <int Cols, int Rows>
+struct FixedGeometry
+{
+    static const int cols   = Cols;
+    static const int rows   = Rows;
+    static const int stride = Rows + 2;                 // padded grid stride
+    static const int cells  = (Cols + 2) * (Rows + 2);  // padded grid size
+
+    int colDimension ( ) const { return Cols; }
+    int rowDimension ( ) const { return Rows; }
+};
+
+struct DynamicGeometry
+{
+    int cols;
+    int rows;
+
+    int colDimension ( ) const { return cols; }
+    int rowDimension ( ) const { return rows; }
+};
+
+typedef FixedGeometry<8, 8>   BeginnerGeometry;
+typedef FixedGeometry<16, 16> IntermediateGeometry;
+typedef FixedGeometry<30, 16> ExpertGeometry;
+
+// Call visitor(geometry) with the instantiation matching the runtime
+// dimensions, or with the dynamic geometry for any other size.
+template <class Visitor>
+void withGeometry ( int cols, int rows, Visitor& visitor )
+{
+    if ( cols == BeginnerGeometry::cols && rows == BeginnerGeometry::rows )
+        visitor( BeginnerGeometry() );
+    else if ( cols == IntermediateGeometry::cols && rows == IntermediateGeometry::rows )
+        visitor( IntermediateGeometry() );
+    else if ( cols == ExpertGeometry::cols && rows == ExpertGeometry::rows )
+        visitor( ExpertGeometry() );
+    else
+    {
+        DynamicGeometry geometry = { cols, rows };
+        visitor( geometry );
+    }
+}
+
+// Boards above this many tiles are huge: the World and MyAI keep them in a
+// ChunkedGrid (see ChunkedGrid.hpp) instead of one dense array.
+const long hugeBoardTiles = 1L << 20;
+const long maxBoardTiles  = 1L << 30;      // keeps tile indices and the move limit in an int
+
+inline bool isHugeBoard ( int cols, int rows )
+{
+    return (long) cols * rows > hugeBoardTiles;
+}
+
+// Number of the 8 neighbours of a padded grid cell equal to value.
+// The neighbours are listed in MyAI's scan order.
+inline int countAround ( const int* cell, int stride, int value )
+{
+    return ( cell[-stride - 1] == value ) + ( cell[-1] == value ) + ( cell[stride - 1] == value )
+         + ( cell[-stride + 1] == value ) + ( cell[1] == value )  + ( cell[stride + 1] == value )
+         + ( cell[-stride] == value )     + ( cell[stride] == value );
+}
+
+// The same with the stride of a fixed geometry: every offset is a constant
+// and the eight loads address cell directly.
+template <int Stride>
+inline int countAround ( const int* cell, int value )
+{
+    return ( cell[-Stride - 1] == value ) + ( cell[-1] == value ) + ( cell[Stride - 1] == value )
+         + ( cell[-Stride + 1] == value ) + ( cell[1] == value )  + ( cell[Stride + 1] == value )
+         + ( cell[-Stride] == value )     + ( cell[Stride] == value );
+}
+
+// Offsets of the 8 neighbours of a padded grid cell, in MyAI's scan order.
+inline void neighbourOffsets ( int stride, int offsets[8] )
+{
+    offsets[0] = -stride - 1;
+    offsets[1] = -1;
+    offsets[2] = stride - 1;
+    offsets[3] = -stride + 1;
+    offsets[4] = 1;
+    offsets[5] = stride + 1;
+    offsets[6] = -stride;
+    offsets[7] = stride;
+}
+
+#endif //MINE_SWEEPER_CPP_SHELL_GEOMETRY_HPP
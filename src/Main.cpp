@@ -18,9 +18,114 @@
 //						-m Use the ManualAI instead of MyAI.
 //						-r Use the RandomAI instead of MyAI.
 //                      -d Debug mode, which displays the game board
-//                         after every mode. Useless with -m.
+//                         after every mode. Useless with -m. On a terminal
+//                         only the tiles that changed are redrawn.
+//                      -n Non-interactive: with -d, frames follow each
+//                         other without the "Press ENTER" pause, so a
+//                         debug trace can be captured at full speed.
 //                      -v Verbose mode displays world file names before
 //                         loading them.
+//                      -s Speculative mode: MyAI solves the frontier it
+//                         expects next in the background while the
+//                         World applies its move, and reports how many
+//                         of those solves the next move used.
+//                      -p Portfolio mode: MyAI races rule propagation,
+//                         exhaustive enumeration and sampling on every
+//                         frontier and reports the wins per strategy.
+//                      -h Headless mode: worlds run in a tight loop with
+//                         no per-move or per-world printing; a folder run
+//                         ends with games, moves and games per second.
+//                         Overrides -d, ignored with -m.
+//                      -c Cascade mode: uncovering a 0 reveals its whole
+//                         zero region in one move, and agents that accept
+//                         it get the full list of revealed tiles.
+//                      -b Batch mode: agents that support it submit every
+//                         move they can commit to in one call, and get
+//                         all the reveals back in the next one. MyAI
+//                         plays the same game as without -b, move for
+//                         move, except with -c: a batch cannot see the
+//                         zero regions its own moves open, so it may
+//                         play moves one call at a time would skip.
+//                      -g Generate mode: InputFile is a spec N:RxC/M[@S]
+//                         and the program plays N worlds of R rows, C
+//                         columns and M mines generated in memory, with
+//                         the same distribution as WorldGenerator.py.
+//                         S seeds the generator (default: the clock).
+//                         Displays the total score as with a folder.
+//                         Boards over 2^20 tiles (up to 2^30) are laid
+//                         out lazily in 64x64 chunks as they are reached,
+//                         so memory follows the revealed area.
+//                      --seed S Run seed (default: the clock). World i of
+//                         a run, in the order the worlds are played, is
+//                         seeded with S + i and replays exactly from it.
+//                         May appear anywhere on the command line.
+//                      -j N Run the worlds of a folder (-f) on N threads
+//                         (0: one per core), largest boards first. Seeds
+//                         and totals are those of the serial run; only the
+//                         order of the per-world lines may differ. Ignored
+//                         with -m and with -d unless -h is on.
+//                         May appear anywhere on the command line.
+//                      --shard i/N Play only the worlds n of the run
+//                         (folder or -g) with n % N == i, n counted as in
+//                         the single run so each world keeps its seed, and
+//                         write partial results to OutputFile (default:
+//                         the console): one line per world with its score,
+//                         moves and time, then the shard's totals. Shards
+//                         of a folder must list it in the same order (one
+//                         shared filesystem, or the same copy).
+//                      --merge File... Add up the partial results of all
+//                         N shards of a run and display the totals of the
+//                         single run.
+//                      --pack Folder Corpus Pack the worlds of Folder
+//                         into the single file Corpus and exit. With -f, a
+//                         Corpus runs like the folder it was packed from
+//                         (same worlds, order, seeds and totals), but its
+//                         worlds are read from memory without parsing.
+//                      --stream Read worlds from stdin (a pipe or a FIFO)
+//                         and play each one as it arrives, until the input
+//                         ends. A record is a path to a world file on one
+//                         line, or a world inline: the text of a world file,
+//                         recognised by its first line "rows cols". World n
+//                         of the stream is seeded with S + n and gets one
+//                         line "world: n score moves micros name" ("timeout:"
+//                         if it ran out of time), or "failed: n name" if it
+//                         cannot be loaded; lines go
+//                         out in batches, and whenever the program waits for
+//                         input. Records are read only when the program is
+//                         ready for them, so a writer that gets ahead blocks
+//                         on the full pipe. The totals follow at the end, or
+//                         go to OutputFile, given right after the options.
+//                         Not with -m; -d frames never pause.
+//                      --records File Write one record per world to File
+//                         (- for the console): JSON Lines, or CSV when File
+//                         ends in .csv. A record holds the world's id (n as
+//                         for --shard) and name, rows, cols, mines, result
+//                         (won, mine, left, out_of_moves or failed), score,
+//                         moves, guesses (-1 if the agent does not count
+//                         them), wall and agent time in microseconds, and
+//                         seed. Records are buffered and written a megabyte
+//                         at a time. Timing the agent costs two clock reads
+//                         a move, so it is only on with --records.
+//                      --move-budget MS, --world-budget MS Time budgets
+//                         in milliseconds for each move and for each world
+//                         (default: none). A watchdog thread stops a world
+//                         that goes over either one; MyAI cuts its search
+//                         short and guesses, and the World ends the game
+//                         with the outcome timeout. The run goes on with
+//                         the next world; each timeout is reported on
+//                         stderr as it happens, and the totals list the
+//                         ids (n as for --shard) of the worlds that timed
+//                         out. Budgets are enforced cooperatively, within
+//                         a quarter of the smallest budget or so.
+//                      --self-check Build 1000 worlds of each tournament
+//                         size (and some larger ones) from the run seed,
+//                         check that the bit-sliced neighbour counts match
+//                         the scalar path on every one, check that a
+//                         snapshot restored after a rollout gives back the
+//                         exact game state, check that -s plays the same
+//                         games and uses some of its solves, and exit:
+//                         status 0 and "self-check: ok", or 1 and the
+//                         mismatches.
 //                      -f Depending on the InputFile format supplied,
 //                         this operand will trigger program
 //                         1) Treats the InputFile as a folder containing many worlds.
@@ -45,20 +150,814 @@
 #include <iostream>
 #include <dirent.h>
 #include <cmath>
+#include <chrono>
+#include <cstdio>
 #include "World.hpp"
+#include "WorkStealingPool.hpp"
+#include "Corpus.hpp"
 #include <sys/stat.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
 
 
 using namespace std;
 
+// Tallies of a many-world run (folder or generated)
+struct RunTotals
+{
+    unsigned long seed = 0;
+    double sumOfScores = 0;
+    int easy = 0;
+    int medium = 0;
+    int expert = 0;
+    long games = 0;
+    long moves = 0;
+    bool budgeted = false;          // a time budget is set: report the timeouts, even none
+    vector<long> timedOut;          // ids of the worlds that ran out of time
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    void add ( const World::Summary& summary, long id )
+    {
+        add( summary.moves, summary.score );
+        if ( summary.outcome == World::TIMEOUT )
+            timedOut.push_back( id );
+    }
+
+    void add ( int gameMoves, int score )
+    {
+        ++games;
+        moves += gameMoves;
+        if (score == 3)
+            ++expert;
+        else if (score == 2)
+            ++medium;
+        else if (score == 1)
+            ++easy;
+        sumOfScores += score;
+    }
+
+    // Fold in the tallies of another part of the same run
+    void merge ( const RunTotals& other )
+    {
+        sumOfScores += other.sumOfScores;
+        easy   += other.easy;
+        medium += other.medium;
+        expert += other.expert;
+        games  += other.games;
+        moves  += other.moves;
+        timedOut.insert( timedOut.end(), other.timedOut.begin(), other.timedOut.end() );
+    }
+};
+
+// --shard i/N: world n of the run belongs to shard n % N
+struct Shard
+{
+    int index = 0;
+    int count = 1;
+
+    bool selects ( long n ) const { return n % count == index; }
+};
+
+// Partial results of a shard, for --merge: a header, one line per world as it ends, then the
+// shard's totals. Lines are "key: value"; world lines are "world: n score moves micros name",
+// or "timeout: ..." with the same fields for a world that ran out of time.
+class PartialResults
+{
+public:
+    PartialResults ( const Shard& shard, unsigned long seed, const string& outputFile )
+        : out( outputFile == "" ? cout : file )
+    {
+        if ( outputFile != "" )
+            file.open( outputFile );
+        out << "shard: " << shard.index << "/" << shard.count << "\n";
+        out << "seed: " << seed << "\n";
+    }
+
+    // Thread-safe, for -j
+    void world ( long n, const string& name, const World::Summary& summary, chrono::steady_clock::duration time )
+    {
+        lock_guard<mutex> guard( lock );
+        out << ( summary.outcome == World::TIMEOUT ? "timeout: " : "world: " ) << n << " " << summary.score << " " << summary.moves << " "
+            << chrono::duration_cast<chrono::microseconds>( time ).count() << " " << name << "\n";
+    }
+
+    // The world failed to load: as in a single run, the score is lost and no later world counts
+    void failed ( long n )
+    {
+        lock_guard<mutex> guard( lock );
+        out << "failed: " << n << "\n";
+    }
+
+    void finish ( const RunTotals& totals )
+    {
+        out << "easy: " << totals.easy << "\n";
+        out << "medium: " << totals.medium << "\n";
+        out << "expert: " << totals.expert << "\n";
+        out << "score: " << totals.sumOfScores << "\n";
+        out << "games: " << totals.games << "\n";
+        out << "moves: " << totals.moves << "\n";
+        if ( totals.budgeted )
+            out << "timeouts: " << totals.timedOut.size() << "\n";
+        out << flush;
+    }
+
+private:
+    ofstream    file;
+    ostream&    out;
+    mutex       lock;
+};
+
+// --records File: one record per world, JSON Lines, or CSV when File ends in .csv ("-" is
+// the console). Records collect in a large buffer that is written out when it fills and at
+// the end, so output costs one write per megabyte; thread-safe, for -j.
+class RecordWriter
+{
+public:
+    explicit RecordWriter ( const string& path )
+        : csv( path.size() >= 4 && path.compare( path.size() - 4, 4, ".csv" ) == 0 )
+    {
+        fd = path == "-" ? STDOUT_FILENO : open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if ( fd < 0 )
+            cout << "[ERROR] Cannot write " << path << "; no records will be written." << endl;
+        buffer.reserve( bufferSize );
+        if ( csv )
+            buffer += "world,name,rows,cols,mines,result,score,moves,guesses,wall_us,agent_us,seed\n";
+    }
+
+    ~RecordWriter ( )
+    {
+        flush();
+        if ( fd > STDOUT_FILENO )
+            close( fd );
+    }
+
+    void world ( long n, const string& name, const World::Summary& summary, chrono::steady_clock::duration wall )
+    {
+        static const char* const outcomes[] = { "out_of_moves", "left", "mine", "timeout" };
+        record( n, name, summary, summary.score > 0 ? "won" : outcomes[summary.outcome],
+                chrono::duration_cast<chrono::microseconds>( wall ).count() );
+    }
+
+    // The world could not be loaded: only its id and name are known
+    void failed ( long n, const string& name )
+    {
+        record( n, name, World::Summary(), "failed", 0 );
+    }
+
+    void flush ( )
+    {
+        lock_guard<mutex> guard( lock );
+        writeOut();
+    }
+
+    static const size_t bufferSize = 1 << 20;
+
+private:
+    bool    csv;
+    int     fd;
+    string  buffer;
+    mutex   lock;
+
+    void record ( long n, const string& name, const World::Summary& summary, const char* result, long wallMicros )
+    {
+        char fields[256];
+        lock_guard<mutex> guard( lock );
+        if ( csv )
+        {
+            buffer.append( fields, snprintf( fields, sizeof fields, "%ld,", n ) );
+            appendCsv( name );
+            buffer.append( fields, snprintf( fields, sizeof fields, ",%d,%d,%d,%s,%d,%d,%d,%ld,%ld,%lu\n",
+                summary.rows, summary.cols, summary.mines, result, summary.score, summary.moves,
+                summary.guesses, wallMicros, summary.agentNanos / 1000, summary.seed ) );
+        }
+        else
+        {
+            buffer.append( fields, snprintf( fields, sizeof fields, "{\"world\":%ld,\"name\":", n ) );
+            appendJson( name );
+            buffer.append( fields, snprintf( fields, sizeof fields,
+                ",\"rows\":%d,\"cols\":%d,\"mines\":%d,\"result\":\"%s\",\"score\":%d,\"moves\":%d,"
+                "\"guesses\":%d,\"wall_us\":%ld,\"agent_us\":%ld,\"seed\":%lu}\n",
+                summary.rows, summary.cols, summary.mines, result, summary.score, summary.moves,
+                summary.guesses, wallMicros, summary.agentNanos / 1000, summary.seed ) );
+        }
+        if ( buffer.size() > bufferSize - 4096 )
+            writeOut();
+    }
+
+    void appendJson ( const string& text )
+    {
+        buffer += '"';
+        for ( unsigned char c : text )
+        {
+            if ( c == '"' || c == '\\' )
+                buffer += '\\';
+            if ( c < 0x20 )
+            {
+                char escaped[8];
+                buffer.append( escaped, snprintf( escaped, sizeof escaped, "\\u%04x", c ) );
+            }
+            else
+                buffer += c;
+        }
+        buffer += '"';
+    }
+
+    void appendCsv ( const string& text )
+    {
+        if ( text.find_first_of( ",\"\r\n" ) == string::npos )
+        {
+            buffer += text;
+            return;
+        }
+        buffer += '"';
+        for ( char c : text )
+        {
+            if ( c == '"' )
+                buffer += '"';
+            buffer += c;
+        }
+        buffer += '"';
+    }
+
+    // Caller holds lock
+    void writeOut ( )
+    {
+        if ( fd == STDOUT_FILENO )
+            cout.flush();
+        const char* data = buffer.data();
+        size_t left = fd < 0 ? 0 : buffer.size();
+        while ( left > 0 )
+        {
+            ssize_t written = write( fd, data, left );
+            if ( written <= 0 )
+                break;
+            data += written;
+            left -= written;
+        }
+        buffer.clear();
+    }
+};
+
+// --merge: the totals of the single run from the partial results of all its shards. Shard
+// totals are added up; if a world failed to load, the worlds before the first failure are
+// counted from their lines and the score is 0, as in a single run. Returns false if the files
+// are not exactly the N shards of one run.
+bool mergeShards ( const vector<string>& files, RunTotals& totals )
+{
+    vector<bool> seen;
+    long firstFailure = -1;
+    vector<pair<long, pair<int, int>>> worlds;      // n, (moves, score)
+    for ( const string& name : files )
+    {
+        ifstream file( name );
+        if ( !file )
+        {
+            cout << "[ERROR] Cannot read " << name << "." << endl;
+            return false;
+        }
+
+        Shard shard;
+        unsigned long seed = 0;
+        string key;
+        while ( file >> key )
+        {
+            if ( key == "shard:" )
+            {
+                char slash;
+                file >> shard.index >> slash >> shard.count;
+                if ( seen.empty() )
+                    seen.assign( shard.count, false );
+                if ( shard.count != (int) seen.size() || shard.index < 0 || shard.index >= shard.count || seen[shard.index] )
+                {
+                    cout << "[ERROR] " << name << ": shard " << shard.index << "/" << shard.count << " does not fit the other files." << endl;
+                    return false;
+                }
+                seen[shard.index] = true;
+            }
+            else if ( key == "seed:" )
+            {
+                file >> seed;
+                if ( &name != &files[0] && seed != totals.seed )
+                {
+                    cout << "[ERROR] " << name << ": seed " << seed << " is not the seed of the other files." << endl;
+                    return false;
+                }
+                totals.seed = seed;
+            }
+            else if ( key == "world:" || key == "timeout:" )
+            {
+                long n;
+                int score, moves;
+                file >> n >> score >> moves;
+                worlds.push_back( { n, { moves, score } } );
+                if ( key == "timeout:" )
+                {
+                    totals.timedOut.push_back( n );
+                    totals.budgeted = true;
+                }
+                getline( file, key );
+            }
+            else if ( key == "failed:" )
+            {
+                long n;
+                file >> n;
+                if ( firstFailure < 0 || n < firstFailure )
+                    firstFailure = n;
+            }
+            else
+            {
+                long value;
+                file >> value;
+                if ( key == "easy:" )           totals.easy   += value;
+                else if ( key == "medium:" )    totals.medium += value;
+                else if ( key == "expert:" )    totals.expert += value;
+                else if ( key == "score:" )     totals.sumOfScores += value;
+                else if ( key == "games:" )     totals.games  += value;
+                else if ( key == "moves:" )     totals.moves  += value;
+                else if ( key == "timeouts:" )  totals.budgeted = true;
+            }
+        }
+    }
+
+    for ( int index = 0; index < (int) seen.size(); ++index )
+        if ( !seen[index] )
+        {
+            cout << "[ERROR] Shard " << index << "/" << seen.size() << " is missing." << endl;
+            return false;
+        }
+
+    if ( firstFailure >= 0 )
+    {
+        RunTotals prefix;
+        prefix.seed = totals.seed;
+        prefix.budgeted = totals.budgeted;
+        for ( const pair<long, pair<int, int>>& world : worlds )
+            if ( world.first < firstFailure )
+                prefix.add( world.second.first, world.second.second );
+        for ( long n : totals.timedOut )
+            if ( n < firstFailure )
+                prefix.timedOut.push_back( n );
+        prefix.sumOfScores = 0;
+        totals = prefix;
+    }
+    return !seen.empty();
+}
+
+// --stream: lines in from one descriptor, result lines out to another. Results are
+// written every flushEvery lines and before every read that may wait, so a consumer
+// sees each result once no more input is at hand.
+class WorldStream
+{
+public:
+    WorldStream ( int _input, int _output ) : input( _input ), output( _output ), start( 0 ), pending( 0 ) {}
+
+    // The next line, without its line break; false once the input has ended
+    bool readLine ( string& line )
+    {
+        for ( ;; )
+        {
+            size_t end = in.find( '\n', start );
+            if ( end != string::npos )
+            {
+                line.assign( in, start, end - start );
+                start = end + 1;
+                if ( !line.empty() && line.back() == '\r' )
+                    line.pop_back();
+                return true;
+            }
+
+            in.erase( 0, start );
+            start = 0;
+            flush();
+            char chunk[65536];
+            ssize_t got = read( input, chunk, sizeof chunk );
+            if ( got <= 0 )
+            {
+                // The last line may have no line break
+                if ( in.empty() )
+                    return false;
+                line.swap( in );
+                in.clear();
+                return true;
+            }
+            in.append( chunk, got );
+        }
+    }
+
+    void result ( const string& line )
+    {
+        out += line;
+        out += '\n';
+        if ( ++pending >= flushEvery )
+            flush();
+    }
+
+    void flush ( )
+    {
+        // Whatever went through cout so far comes first
+        cout.flush();
+        const char* data = out.data();
+        size_t left = out.size();
+        while ( left > 0 )
+        {
+            ssize_t written = write( output, data, left );
+            if ( written <= 0 )
+                break;
+            data += written;
+            left -= written;
+        }
+        out.clear();
+        pending = 0;
+    }
+
+    static const int flushEvery = 64;
+
+private:
+    int     input;
+    int     output;
+    string  in;
+    size_t  start;          // of the next line in in
+    string  out;
+    int     pending;        // result lines in out
+};
+
+// Play the worlds of a stream (--stream) with one arena and one agent, and return the totals
+RunTotals runStream ( WorldStream& stream, const string& aiType, unsigned long runSeed,
+                      bool debug, bool headless, bool cascade, bool batch, RecordWriter* records,
+                      Watchdog& watchdog )
+{
+    RunTotals totals;
+    totals.seed = runSeed;
+    Arena arena;
+    unique_ptr<Agent> agent( World::makeAgent( aiType ) );
+
+    string line, more, record, owned;
+    long n = 0;
+    while ( stream.readLine( line ) )
+    {
+        if ( line.find_first_not_of( " \t" ) == string::npos )
+            continue;
+
+        // Inline world: "rows cols" and nothing else, then the rest of the world file
+        const char* text = nullptr;
+        size_t size = 0;
+        string name = line;
+        bool loaded;
+        int rows, cols, extra;
+        TextScanner header( line.data(), line.size() );
+        if ( header.readInt( rows ) && header.readInt( cols ) && !header.readInt( extra ) && header.eof() )
+        {
+            name = "inline";
+            record = line + '\n';
+            loaded = rows >= 1 && cols >= 1 && (long) rows * cols <= maxBoardTiles;
+            for ( int k = 0; loaded && k <= rows; ++k )
+            {
+                loaded = stream.readLine( more );
+                record += more;
+                record += '\n';
+            }
+            text = record.data();
+            size = record.size();
+        }
+        else
+            loaded = TextScanner::readFile( line, &arena, owned, text, size );
+
+        // A bad first move ends a single-world run; here it only fails its world
+        if ( loaded )
+        {
+            TextScanner check( text, size );
+            int x, y;
+            loaded = check.readInt( rows ) && check.readInt( cols ) && check.readInt( x ) && check.readInt( y )
+                  && rows >= 1 && cols >= 1 && (long) rows * cols <= maxBoardTiles
+                  && 1 <= x && x <= cols && 1 <= y && y <= rows;
+        }
+
+        char result[64];
+        try {
+            if ( !loaded )
+                throw exception();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            TextScanner file( text, size );
+            World world(debug, aiType, file, runSeed + n, headless, cascade, batch, &arena, agent.get());
+            world.watchWith( watchdog.slot( 0, n ) );
+            int score = world.run();
+            totals.add( world.summary(), n );
+            long micros = chrono::duration_cast<chrono::microseconds>( chrono::steady_clock::now() - start ).count();
+            snprintf( result, sizeof result, "%s: %ld %d %d %ld ", world.summary().outcome == World::TIMEOUT ? "timeout" : "world",
+                      n, score, world.summary().moves, micros );
+            if ( records )
+                records->world( n, name, world.summary(), chrono::steady_clock::now() - start );
+        }
+        catch (...) {
+            snprintf( result, sizeof result, "failed: %ld ", n );
+            if ( records )
+                records->failed( n, name );
+        }
+        stream.result( result + name );
+        arena.reset();
+        ++n;
+    }
+    stream.flush();
+    return totals;
+}
+
+// Folder run on jobs threads (-j). World n of the folder, in readdir order, gets seed
+// runSeed + n as in the serial loop; the worlds are played largest board first, each
+// thread with its own arena, agent and totals, and the totals are reduced at the end.
+// As in the serial loop, a world that fails to load zeroes the score and drops itself
+// and every world after it. Only the worlds of shard are played; partial, if any, gets
+// their results, as does records. With a corpus, dir is unused and world n is world n of
+// the corpus.
+RunTotals runFolderParallel ( DIR* dir, const string& worldFile, const string& aiType, unsigned long runSeed,
+                              bool headless, bool cascade, bool batch, bool verbose, int jobs,
+                              const Shard& shard, PartialResults* partial, RecordWriter* records,
+                              Watchdog& watchdog, const Corpus* corpus = nullptr )
+{
+    RunTotals totals;
+    totals.seed = runSeed;
+
+    vector<string> names;
+    vector<long> tiles;
+    if ( corpus )
+    {
+        for ( int n = 0; n < corpus->count(); ++n )
+        {
+            const Corpus::Entry& entry = *corpus->world( n ).entry;
+            names.push_back( entry.name );
+            tiles.push_back( (long) entry.rows * entry.cols );
+        }
+    }
+    else
+    {
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL)
+            if (ent->d_name[0] != '.')
+                names.push_back( ent->d_name );
+
+        // Board size from the first line of each file; unreadable files count as empty
+        tiles.assign( names.size(), 0 );
+        for ( size_t n = 0; n < names.size(); ++n )
+        {
+            ifstream file( worldFile + "/" + names[n] );
+            long rows = 0, cols = 0;
+            if ( file >> rows >> cols )
+                tiles[n] = rows * cols;
+        }
+    }
+    const int count = names.size();
+    vector<int> order;
+    for ( int n = 0; n < count; ++n )
+        if ( shard.selects( n ) )
+            order.push_back( n );
+    stable_sort( order.begin(), order.end(), [&tiles]( int a, int b ) { return tiles[a] > tiles[b]; } );
+
+    vector<RunTotals> threadTotals( jobs );
+    vector<unique_ptr<Arena>> arenas;
+    vector<unique_ptr<Agent>> agents;
+    for ( int worker = 0; worker < jobs; ++worker )
+    {
+        arenas.emplace_back( new Arena() );
+        agents.emplace_back( World::makeAgent( aiType ) );
+    }
+    vector<World::Summary> results( count );    // per world, only read if a world fails
+    atomic<int> firstFailure( count );
+    mutex printLock;
+
+    WorkStealingPool::run( jobs, order, [&]( int worker, int n )
+    {
+        if ( n > firstFailure )
+            return;
+        unsigned long seed = runSeed + n;
+        string individualWorldFile = worldFile + ( corpus ? ":" : "/" ) + names[n];
+        if ( verbose || !headless )
+        {
+            lock_guard<mutex> guard( printLock );
+            if (verbose)
+                cout << "Running world: " << names[n] << " (seed " << seed << ")" << '\n';
+            if ( !headless )
+                cout << individualWorldFile << '\n';
+        }
+
+        try {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            auto play = [&]( World& world )
+            {
+                world.watchWith( watchdog.slot( worker, n ) );
+                world.run();
+                threadTotals[worker].add( world.summary(), n );
+                results[n] = world.summary();
+                if ( partial )
+                    partial->world( n, names[n], results[n], chrono::steady_clock::now() - start );
+                if ( records )
+                    records->world( n, names[n], results[n], chrono::steady_clock::now() - start );
+            };
+            if ( corpus )
+            {
+                World world(false, aiType, corpus->world( n ), seed, headless, cascade, batch, arenas[worker].get(), agents[worker].get());
+                play( world );
+            }
+            else
+            {
+                World world(false, aiType, individualWorldFile, seed, headless, cascade, batch, arenas[worker].get(), agents[worker].get());
+                play( world );
+            }
+        }
+        catch (...) {
+            int failure = firstFailure;
+            while ( n < failure && !firstFailure.compare_exchange_weak( failure, n ) )
+                ;
+            if ( partial )
+                partial->failed( n );
+            if ( records )
+                records->failed( n, names[n] );
+        }
+        arenas[worker]->reset();
+    } );
+
+    if ( firstFailure == count )
+    {
+        for ( const RunTotals& part : threadTotals )
+            totals.merge( part );
+    }
+    else
+    {
+        for ( int n = 0; n < firstFailure; ++n )
+            if ( shard.selects( n ) )
+                totals.add( results[n], n );
+        totals.sumOfScores = 0;
+    }
+    return totals;
+}
+
+// The worlds that ran out of time, by id, after the totals
+void reportTimeouts ( const RunTotals& totals, ostream& out )
+{
+    if ( !totals.budgeted && totals.timedOut.empty() )
+        return;
+    vector<long> ids( totals.timedOut );
+    sort( ids.begin(), ids.end() );
+    out << "timeouts: " << ids.size() << endl;
+    if ( !ids.empty() )
+    {
+        out << "timed out:";
+        for ( long id : ids )
+            out << " " << id;
+        out << endl;
+    }
+}
+
+// Print the totals to the console, or write them to outputFile when one is given
+void reportTotals ( const RunTotals& totals, const string& outputFile, bool headless )
+{
+    if ( outputFile == "" )
+    {
+
+        cout << "seed: " << totals.seed << endl;
+        cout << "easy: " << totals.easy << endl;
+        cout << "medium: "  << totals.medium << endl;
+        cout << "expert: " << totals.expert << endl;
+        cout << "score: " << totals.sumOfScores << endl;
+        reportTimeouts( totals, cout );
+        if ( headless )
+        {
+            double seconds = chrono::duration<double>( chrono::steady_clock::now() - totals.start ).count();
+            cout << "games: " << totals.games << endl;
+            cout << "moves: " << totals.moves << endl;
+            cout << "games per second: " << ( seconds > 0 ? totals.games / seconds : 0 ) << endl;
+        }
+        if ( MyAI::portfolioMode )
+            MyAI::printPortfolioStats( cout );
+        if ( MyAI::speculativeMode )
+            MyAI::printSpeculationStats( cout );
+#ifdef MYAI_STATS
+        MyAI::printCorpusStats( cout );
+#endif
+    }
+    else
+    {
+        ofstream file;
+        file.open( outputFile );
+        file << "seed: " << totals.seed << endl;
+        file << "easy: "  << totals.easy << endl;
+        file << "medium: " << totals.medium << endl;
+        file << "expert: " << totals.expert << endl;
+        file << "score: " << totals.sumOfScores << endl;
+        reportTimeouts( totals, file );
+        file.close();
+    }
+}
+
 int main( int argc, char *argv[] )
 {
 
-    // Set random seed
-    srand( time ( NULL ) );
+    // Set random seed, taking --seed S out of the arguments
+    unsigned long runSeed = time ( NULL );
+    bool    selfCheck    = false;
+    bool    merge        = false;
+    bool    pack         = false;
+    bool    stream       = false;
+    string  recordsFile  = "";
+    long    moveBudget   = 0;
+    long    worldBudget  = 0;
+    int     jobs         = 1;
+    Shard   shard;
+    bool    sharded      = false;
+    vector<char*> args;
+    for ( int index = 0; index < argc; ++index )
+    {
+        if ( strcmp( argv[index], "--seed" ) == 0 && index + 1 < argc )
+            runSeed = strtoul( argv[++index], NULL, 10 );
+        else if ( strcmp( argv[index], "-j" ) == 0 && index + 1 < argc )
+            jobs = atoi( argv[++index] );
+        else if ( strcmp( argv[index], "--self-check" ) == 0 )
+            selfCheck = true;
+        else if ( strcmp( argv[index], "--merge" ) == 0 )
+            merge = true;
+        else if ( strcmp( argv[index], "--pack" ) == 0 )
+            pack = true;
+        else if ( strcmp( argv[index], "--stream" ) == 0 )
+            stream = true;
+        else if ( strcmp( argv[index], "--records" ) == 0 && index + 1 < argc )
+            recordsFile = argv[++index];
+        else if ( strcmp( argv[index], "--move-budget" ) == 0 && index + 1 < argc )
+            moveBudget = max( 0L, atol( argv[++index] ) );
+        else if ( strcmp( argv[index], "--world-budget" ) == 0 && index + 1 < argc )
+            worldBudget = max( 0L, atol( argv[++index] ) );
+        else if ( strcmp( argv[index], "--shard" ) == 0 && index + 1 < argc )
+        {
+            sharded = true;
+            if ( sscanf( argv[++index], "%d/%d", &shard.index, &shard.count ) != 2
+                 || shard.count < 1 || shard.index < 0 || shard.index >= shard.count )
+            {
+                cout << "[ERROR] Shard must be i/N with 0 <= i < N." << endl;
+                return 0;
+            }
+        }
+        else
+            args.push_back( argv[index] );
+    }
+    argc = args.size();
+    argv = args.data();
+
+    if ( selfCheck )
+    {
+        int mismatches = World::checkMineCounts( 1000, runSeed );
+        int unrestored = World::checkSnapshots( 1000, runSeed );
+        int diverged   = World::checkSpeculation( 200, runSeed );
+        bool ok = mismatches == 0 && unrestored == 0 && diverged == 0 && MyAI::speculativeHits > 0;
+        if ( ok )
+            cout << "self-check: ok (seed " << runSeed << ")" << endl;
+        if ( mismatches != 0 )
+            cout << "self-check: " << mismatches << " worlds with wrong neighbour counts (seed " << runSeed << ")" << endl;
+        if ( unrestored != 0 )
+            cout << "self-check: " << unrestored << " worlds not restored by their snapshot (seed " << runSeed << ")" << endl;
+        if ( diverged != 0 )
+            cout << "self-check: " << diverged << " games played differently with -s (seed " << runSeed << ")" << endl;
+        if ( MyAI::speculativeHits == 0 )
+            cout << "self-check: -s used none of its " << MyAI::speculativeSolves << " solves (seed " << runSeed << ")" << endl;
+        return ok ? 0 : 1;
+    }
+
+    if ( pack )
+    {
+        if ( argc != 3 )
+        {
+            cout << "[ERROR] --pack takes a folder and a corpus file." << endl;
+            return 1;
+        }
+        return Corpus::pack( argv[1], argv[2] ) ? 0 : 1;
+    }
+
+    if ( merge )
+    {
+        RunTotals totals;
+        if ( !mergeShards( vector<string>( argv + 1, argv + argc ), totals ) )
+        {
+            if ( argc == 1 )
+                cout << "[ERROR] No partial results to merge." << endl;
+            return 1;
+        }
+        reportTotals( totals, "", false );
+        return 0;
+    }
 
-    if ( argc == 1 ){
-        World world(false, std::string(), std::string());
+    // Per-world records, with the agent's time
+    unique_ptr<RecordWriter> records( recordsFile == "" ? nullptr : new RecordWriter( recordsFile ) );
+    World::timeAgent = records != nullptr;
+
+    // Time budgets: one watchdog slot per thread that plays worlds
+    if ( jobs < 1 )
+        jobs = max( 1u, thread::hardware_concurrency() );
+    Watchdog watchdog( jobs, moveBudget, worldBudget );
+
+    if ( argc == 1 && !stream ){
+        World world(false, std::string(), std::string(), runSeed);
         int score = world.run();
         if (score)
             cout << "WORLD COMPLETE" << endl;
@@ -69,12 +968,17 @@ int main( int argc, char *argv[] )
 
     // Important Variables
     bool 	debug        = false;
+    bool    headless     = false;
+    bool    cascade      = false;
+    bool    batch        = false;
     bool	verbose      = false;
     string  aiType       = "MyAI";
     bool 	folder       = false;
+    bool    corpus       = false;
+    bool    generate     = false;
     string	worldFile    = "";
     string	outputFile   = "";
-    string 	firstToken 	 = argv[1];
+    string 	firstToken 	 = argc > 1 ? argv[1] : "";
 
     // read options if there are options
     if ( firstToken[0] == '-' )
@@ -91,6 +995,7 @@ int main( int argc, char *argv[] )
                 worldFile = argv[2];
                 stat ( worldFile.c_str(), &path_stat );
                 folder = S_ISDIR ( path_stat.st_mode );
+                corpus = !folder && Corpus::isCorpus( worldFile );
             }
 
             if ( firstToken[index] == 'v' || firstToken[index] =='V' )
@@ -110,6 +1015,23 @@ int main( int argc, char *argv[] )
             }
             if (firstToken[index] == 'd' || firstToken[index] == 'D')
                 debug = true;
+            if (firstToken[index] == 'n' || firstToken[index] == 'N')
+                World::interactive = false;
+            if (firstToken[index] == 's' || firstToken[index] == 'S')
+                MyAI::speculativeMode = true;
+            if (firstToken[index] == 'p' || firstToken[index] == 'P')
+                MyAI::portfolioMode = true;
+            if (firstToken[index] == 'h' || firstToken[index] == 'H')
+                headless = true;
+            if (firstToken[index] == 'c' || firstToken[index] == 'C')
+                cascade = true;
+            if (firstToken[index] == 'b' || firstToken[index] == 'B')
+                batch = true;
+            if ( (firstToken[index] == 'g' || firstToken[index] == 'G') && argc >= 3 )
+            {
+                generate = true;
+                worldFile = argv[2];
+            }
 
         }
 
@@ -119,12 +1041,31 @@ int main( int argc, char *argv[] )
 
     }
 
+    // worlds read from stdin for --stream turning on
+    if ( stream )
+    {
+        if ( aiType == "manualAI" )
+        {
+            cout << "[ERROR] The ManualAI cannot play a stream: stdin carries the worlds." << endl;
+            return 0;
+        }
+        // Frames must not wait for ENTER on the stream
+        World::interactive = false;
+        if ( argc == 3 )
+            outputFile = argv[2];
+        WorldStream worlds( STDIN_FILENO, STDOUT_FILENO );
+        RunTotals totals = runStream( worlds, aiType, runSeed, debug, headless, cascade, batch, records.get(), watchdog );
+        totals.budgeted = watchdog.enabled();
+        reportTotals( totals, outputFile, headless );
+        return 0;
+    }
+
     // no input folder for -f option turning on
     if ( worldFile == "" )
     {
         if ( folder )
             cout << "[WARNING] No folder specified; running on a random world." << endl;
-        World world(debug, aiType, std::string());
+        World world(debug, aiType, std::string(), runSeed, headless, cascade, batch);
         int score = world.run();
         if (score)
             cout << "WORLD COMPLETE" << endl;
@@ -135,6 +1076,110 @@ int main( int argc, char *argv[] )
 
 
 
+    // worlds generated in memory for -g option turning on
+    if ( generate )
+    {
+        int count, rows, cols, mines;
+        unsigned long seed = runSeed;
+        int fields = sscanf( worldFile.c_str(), "%d:%dx%d/%d@%lu", &count, &rows, &cols, &mines, &seed );
+        if ( fields < 4 || count < 1 )
+        {
+            cout << "[ERROR] Generate spec must be N:RxC/M[@S]." << endl;
+            return 0;
+        }
+        // Same limits as WorldGenerator.py
+        if ( rows < 4 || cols < 4 || mines < 1 || (long) rows * cols > maxBoardTiles || mines > rows * cols - 9 )
+        {
+            cout << "[ERROR] Could not generate worlds: rows >= 4, cols >= 4, rows * cols <= 2^30, 1 <= mines <= rows * cols - 9." << endl;
+            return 0;
+        }
+
+        RunTotals totals;
+        totals.seed = seed;
+        Arena arena;
+        unique_ptr<Agent> agent( World::makeAgent( aiType ) );
+        unique_ptr<PartialResults> partial( sharded ? new PartialResults( shard, seed, outputFile ) : nullptr );
+        for ( int index = 0; index < count; ++index )
+        {
+            if ( !shard.selects( index ) )
+                continue;
+            {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                World world(debug, aiType, rows, cols, mines, seed + index, headless, cascade, batch, &arena, agent.get());
+                world.watchWith( watchdog.slot( 0, index ) );
+                world.run();
+                totals.add( world.summary(), index );
+                if ( partial )
+                    partial->world( index, worldFile, world.summary(), chrono::steady_clock::now() - start );
+                if ( records )
+                    records->world( index, worldFile, world.summary(), chrono::steady_clock::now() - start );
+            }
+            arena.reset();
+        }
+
+        totals.budgeted = watchdog.enabled();
+        if ( partial )
+            partial->finish( totals );
+        else
+            reportTotals( totals, outputFile, headless );
+        return 0;
+    }
+
+
+    // packed corpus for -f option turning on
+    if ( corpus )
+    {
+        Corpus worlds;
+        if ( !worlds.open( worldFile ) )
+        {
+            cout << "[ERROR] Failed to open corpus." << endl;
+            return 0;
+        }
+
+        unique_ptr<PartialResults> partial( sharded ? new PartialResults( shard, runSeed, outputFile ) : nullptr );
+        RunTotals totals;
+        totals.seed = runSeed;
+        if ( jobs > 1 && aiType != "manualAI" && !( debug && !headless ) )
+            totals = runFolderParallel( nullptr, worldFile, aiType, runSeed, headless, cascade, batch, verbose, jobs,
+                                        shard, partial.get(), records.get(), watchdog, &worlds );
+        else
+        {
+            Arena arena;
+            unique_ptr<Agent> agent( World::makeAgent( aiType ) );
+            for ( int index = 0; index < worlds.count(); ++index )
+            {
+                if ( !shard.selects( index ) )
+                    continue;
+                Corpus::Packed packed = worlds.world( index );
+                unsigned long seed = runSeed + index;
+                if (verbose)
+                    cout << "Running world: " << packed.entry->name << " (seed " << seed << ")" << '\n';
+                if ( !headless )
+                    cout << worldFile << ":" << packed.entry->name << '\n';
+
+                {
+                    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                    World world(debug, aiType, packed, seed, headless, cascade, batch, &arena, agent.get());
+                    world.watchWith( watchdog.slot( 0, index ) );
+                    world.run();
+                    totals.add( world.summary(), index );
+                    if ( partial )
+                        partial->world( index, packed.entry->name, world.summary(), chrono::steady_clock::now() - start );
+                    if ( records )
+                        records->world( index, packed.entry->name, world.summary(), chrono::steady_clock::now() - start );
+                }
+                arena.reset();
+            }
+        }
+
+        totals.budgeted = watchdog.enabled();
+        if ( partial )
+            partial->finish( totals );
+        else
+            reportTotals( totals, outputFile, headless );
+        return 0;
+    }
+
     // no input file or invalid file for -f option turning on
     if ( folder )
     {
@@ -145,63 +1190,74 @@ int main( int argc, char *argv[] )
             return 0;
         }
 
+        // Frames and ManualAI prompts need the worlds one at a time
+        unique_ptr<PartialResults> partial( sharded ? new PartialResults( shard, runSeed, outputFile ) : nullptr );
+        if ( jobs > 1 && aiType != "manualAI" && !( debug && !headless ) )
+        {
+            RunTotals totals = runFolderParallel( dir, worldFile, aiType, runSeed, headless, cascade, batch, verbose, jobs,
+                                                  shard, partial.get(), records.get(), watchdog );
+            closedir(dir);
+            totals.budgeted = watchdog.enabled();
+            if ( partial )
+                partial->finish( totals );
+            else
+                reportTotals( totals, outputFile, headless );
+            return 0;
+        }
+
         struct dirent *ent;
 
-        double sumOfScores = 0;
-        int easy = 0;
-        int medium = 0;
-        int expert = 0;
+        RunTotals totals;
+        totals.seed = runSeed;
+        Arena arena;
+        unique_ptr<Agent> agent( World::makeAgent( aiType ) );
 
+        // World n of the folder, in readdir order, whether or not this shard plays it
+        long listed = -1;
         while ((ent = readdir(dir)) != NULL)
         {
             if (ent->d_name[0] == '.')
                 continue;
+            if ( !shard.selects( ++listed ) )
+                continue;
+            unsigned long seed = runSeed + listed;
             if (verbose)
-                cout << "Running world: " << ent->d_name << endl;
+                cout << "Running world: " << ent->d_name << " (seed " << seed << ")" << '\n';
 
             string individualWorldFile = worldFile + "/" + ent->d_name;
-            std::cout << individualWorldFile << std::endl;
+            if ( !headless )
+                std::cout << individualWorldFile << '\n';
 
-            int score;
             try {
-                World world(debug, aiType, individualWorldFile);
-                score = world.run();
-                if (score == 3)
-                    ++expert;
-                else if (score == 2)
-                    ++medium;
-                else if (score == 1)
-                    ++easy;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                World world(debug, aiType, individualWorldFile, seed, headless, cascade, batch, &arena, agent.get());
+                world.watchWith( watchdog.slot( 0, listed ) );
+                world.run();
+                totals.add( world.summary(), listed );
+                if ( partial )
+                    partial->world( listed, ent->d_name, world.summary(), chrono::steady_clock::now() - start );
+                if ( records )
+                    records->world( listed, ent->d_name, world.summary(), chrono::steady_clock::now() - start );
             }
             catch (...) {
-                sumOfScores = 0;
+                totals.sumOfScores = 0;
+                if ( partial )
+                    partial->failed( listed );
+                if ( records )
+                    records->failed( listed, ent->d_name );
                 break;
             }
-
-            sumOfScores += score;
+            arena.reset();
         }
 
         closedir(dir);
 
 
-        if ( outputFile == "" )
-        {
-
-            cout << "easy: " << easy << endl;
-            cout << "medium: "  << medium << endl;
-            cout << "expert: " << expert << endl;
-            cout << "score: " << sumOfScores << endl;
-        }
+        totals.budgeted = watchdog.enabled();
+        if ( partial )
+            partial->finish( totals );
         else
-        {
-            ofstream file;
-            file.open( outputFile );
-            file << "easy: "  << easy << endl;
-            file << "medium: " << medium << endl;
-            file << "expert: " << expert << endl;
-            file << "score: " << sumOfScores << endl;
-            file.close();
-        }
+            reportTotals( totals, outputFile, headless );
         return 0;
     }
 
@@ -209,10 +1265,16 @@ int main( int argc, char *argv[] )
     try
     {
         if ( verbose )
-            cout << "Running world: " << worldFile << endl;
+            cout << "Running world: " << worldFile << " (seed " << runSeed << ")" << endl;
 
-        World world(debug, aiType, worldFile);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        World world(debug, aiType, worldFile, runSeed, headless, cascade, batch);
+        world.watchWith( watchdog.slot( 0, 0 ) );
         int score = world.run();
+        if ( world.summary().outcome == World::TIMEOUT )
+            cout << "WORLD TIMED OUT" << endl;
+        if ( records )
+            records->world( 0, worldFile, world.summary(), chrono::steady_clock::now() - start );
         if ( outputFile == "" )
         {
             if (score)
@@ -234,6 +1296,8 @@ int main( int argc, char *argv[] )
     catch ( const std::exception& e )
     {
         cout << "[ERROR] Failure to open file." << endl;
+        if ( records )
+            records->failed( 0, worldFile );
     }
     return 0;
 }
\ No newline at end of file
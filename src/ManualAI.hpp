@@ -35,6 +35,8 @@ public:
         totalMines   = _totalMines;
     };
 
+    using Agent::getAction;
+
     Action getAction( int number ) override
     {
         // Print Command Menu
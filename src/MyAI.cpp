@@ -19,53 +19,211 @@
 
 #include "MyAI.hpp"
 
+const int MyAI::BORDER;
+
+bool MyAI::speculativeMode = false;
+
+#ifdef MYAI_STATS
+MyAI::decisionStats MyAI::corpusStats[MyAI::DECISION_TYPES];
+std::vector<const MyAI*> MyAI::liveAgents;
+std::mutex MyAI::corpusStatsLock;
+#endif
+bool MyAI::portfolioMode = false;
+std::atomic<long> MyAI::portfolioWins[MyAI::PORTFOLIO_STRATEGIES];
+std::atomic<long> MyAI::portfolioSavedMicros(0);
+std::atomic<long> MyAI::speculativeSolves(0);
+std::atomic<long> MyAI::speculativeHits(0);
+
 MyAI::MyAI ( int _rowDimension, int _colDimension, int _totalMines, int _agentX, int _agentY ) : Agent()
 {
     // ======================================================================
     // YOUR CODE BEGINS
     // ======================================================================
 
+    reset(_rowDimension, _colDimension, _totalMines, _agentX, _agentY);
+
+#ifdef MYAI_STATS
+    std::lock_guard<std::mutex> guard(corpusStatsLock);
+    liveAgents.push_back(this);
+#endif
+
+};
+
+void MyAI::reset ( int _rowDimension, int _colDimension, int _totalMines, int _agentX, int _agentY )
+{
+    // Same board size as the last game: only the labels that game wrote go back to -2
+    bool sameBoard = !effectiveLabels.empty() && rowDimension == _rowDimension && colDimension == _colDimension;
+    hugeBoard = isHugeBoard(_colDimension, _rowDimension);
+
     rowDimension = _rowDimension;
     colDimension = _colDimension;
     totalMines   = _totalMines;
     agentX = _agentX + 1;
     agentY = _agentY + 1;
 
-    
-    // Initialize vector with -2 (in liu with NULL)
-    // 1 size larger to match the 1-start system of board coordinate
-    std::vector< vector<int> > temp(colDimension + 1, vector<int>(rowDimension + 1, -2));
-    effectiveLabels = temp;
+    if (hugeBoard) {
+        // Every tile starts at -2 without being stored; the border is answered by hugeLabel
+        labelStride = rowDimension + 2;
+        chunkedLabels.assign(colDimension + 2, labelStride, -2);
+        std::vector<int>().swap(effectiveLabels);
+        neighbourOffsets(labelStride, labelOffset);
+    } else if (sameBoard) {
+        for (int index : touchedLabels) {
+            effectiveLabels[index] = -2;
+        }
+    } else {
+        // Initialize labels with -2 (in liu with NULL)
+        // Flat and padded by one BORDER tile on each side (see Geometry.hpp), which also
+        // matches the 1-start system of board coordinate and removes the bounds checks.
+        labelStride = rowDimension + 2;
+        effectiveLabels.assign((colDimension + 2) * labelStride, BORDER);
+        for (int x = 1; x <= colDimension; x++) {
+            for (int y = 1; y <= rowDimension; y++) {
+                label(x, y) = -2;
+            }
+        }
+        neighbourOffsets(labelStride, labelOffset);
+    }
+    touchedLabels.clear();
+
+    // Solver state of the last game; the containers keep their capacity
+    cancelSpeculations();
+    while (pq.empty() != true) {
+        pq.pop();
+    }
+    coveredFrontier.clear();
+    passedAssignments.clear();
+    plan.clear();
+    plannedTiles.clear();
 
     flagCount = 0;
+    guessCount = 0;
     uncoverCount = 1;
+    leftCoveredX = 1;
+    leftCoveredY = 1;
+    pqUpdate = false;
+    workOnFrontier = false;
+    lastDecision = LEAVE_GAME;
+#ifdef MYAI_STATS
+    for (decisionStats& stats : gameStats) {
+        stats = decisionStats();
+    }
+#endif
 
+}
 
-};
+MyAI::~MyAI()
+{
+    cancelSpeculations();
+
+#ifdef MYAI_STATS
+    std::lock_guard<std::mutex> guard(corpusStatsLock);
+    addDecisionStats(corpusStats, runStats);
+    liveAgents.erase(std::find(liveAgents.begin(), liveAgents.end(), this));
+#endif
+}
 
 Agent::Action MyAI::getAction( int number )
-{    
-    // If number = -1, skip
+{
+    MYAI_STAT(callCost = decisionStats());
+    MYAI_STAT(std::chrono::steady_clock::time_point callStart = std::chrono::steady_clock::now());
+
+    Action next = decideAction(number);
+
+    MYAI_STAT(callCost.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - callStart).count());
+    MYAI_STAT(recordDecision());
+
+    // The World is about to apply this move. If its percept can be predicted, start solving
+    // the frontier the next call will see while the World (and any printing) runs.
+    if (speculativeMode) {
+        speculateAfter(next);
+    }
+
+    return next;
+}
+
+Agent::Action MyAI::getAction( const std::vector<Reveal>& reveals )
+{
+    for (const Reveal& tile : reveals) {
+        int x = tile.x + 1;
+        int y = tile.y + 1;
+
+        // Only the tile we uncovered has been counted; the rest of a cascade is
+        // booked here the way uncoverTile books a tile we uncover ourselves.
+        if ((x != agentX || y != agentY) && label(x, y) == -2) {
+            uncoverCount++;
+            updateEffectiveLabels(x, y);
+            eraseFromCoveredFrontier(std::pair<int, int>{x, y});
+        }
+        applyPercept(x, y, tile.number);
+    }
+
+    return getAction(-1);
+}
+
+void MyAI::applyPercept( int x, int y, int number )
+{
     if (number == 0) {
 
-        effectiveLabels[agentX][agentY] = -1;
-        pq.push(usingTile{agentX, agentY, -1});
+        // Every covered neighbor of a zero tile is safe: plan them all now instead of
+        // rediscovering them through the PQ on each of the following calls.
+        touchLabel(x, y) = -1;
+        planOpening(x, y, ZERO_OPENING);
 
-    } else if (number != -1) {
+    } else {
 
         // Previous action is not FLAG/UNFLAG
         // aka. previou action is UNCOVER with number > 0
-        effectiveLabels[agentX][agentY] = getNumNeighborCovered(agentX, agentY) - (number - getNumFlagNeighbor(agentX, agentY));
-        pq.push(usingTile{agentX, agentY, getNumNeighborCovered(agentX, agentY) - (number - getNumFlagNeighbor(agentX, agentY))});
+        touchLabel(x, y) = getNumNeighborCovered(x, y) - (number - getNumFlagNeighbor(x, y));
+
+        // The PQ keeps the number as of this percept. Tiles a batch uncovered after this one
+        // are still PENDING: a single call would have seen them covered, so count them too.
+        int pending = countLabelsAround(x, y, PENDING);
+        pq.push(usingTile{x, y, getNumNeighborCovered(x, y) + pending - (number - getNumFlagNeighbor(x, y))});
+    }
+}
+
+void MyAI::getActions( const std::vector<Reveal>& reveals, std::vector<Action>& actions )
+{
+    actions.push_back(getAction(reveals));
+
+    // Sweeps and planned moves need no new percept, so they go out in the same batch.
+    // Each tile uncovered is PENDING until its percept, so neither picks it twice.
+    // The flag sweep repeats its move until the percepts change, so a repeat ends the batch.
+    Action next = actions.back();
+    while (next.action != LEAVE) {
+        if (next.action == UNCOVER) {
+            touchLabel(next.x + 1, next.y + 1) = PENDING;
+        }
+        Action previous = next;
+        if (sweep(next) != true && resumePlan(next) != true) {
+            break;
+        }
+        MYAI_STAT(callCost = decisionStats());
+        MYAI_STAT(recordDecision());
+        actions.push_back(next);
+        if (next.action == previous.action && next.x == previous.x && next.y == previous.y) {
+            break;
+        }
     }
+}
+
+bool MyAI::sweepReady( )
+{
+    // The two cases sweep() handles
+    return (flagCount == totalMines && uncoverCount < rowDimension * colDimension - totalMines)
+        || uncoverCount == rowDimension * colDimension - totalMines;
+}
 
+bool MyAI::sweep( Action& next )
+{
     // If all mines are FLAGGED, UNCOVER the rest
 
-    if (uncoverCount < (rowDimension * colDimension - totalMines)) {
+    if (flagCount == totalMines && uncoverCount < (rowDimension * colDimension - totalMines)) {
         for (int i = leftCoveredX; i <= colDimension; i++) {
             for (int j = leftCoveredY; j <= rowDimension; j++) {
                     
-                if (effectiveLabels[i][j] == -2) {
+                if (peekLabel(i * labelStride + j) == -2) {
                     leftCoveredX = i;
                     leftCoveredY = j;
                     uncoverCount++;
@@ -73,7 +231,9 @@ Agent::Action MyAI::getAction( int number )
                     agentX = i;
                     agentY = j;
 
-                    return {UNCOVER, i - 1, j - 1};
+                    lastDecision = SWEEP_UNCOVER;
+                    next = {UNCOVER, i - 1, j - 1};
+                    return true;
                 }
 
                 if (j == rowDimension) {
@@ -82,7 +242,9 @@ Agent::Action MyAI::getAction( int number )
             }
         }
             
-        return {LEAVE, 0, 0};
+        lastDecision = LEAVE_GAME;
+        next = {LEAVE, 0, 0};
+        return true;
     }
 
     // If all safe tiles are UNCOVERED, FLAG the rest
@@ -91,7 +253,7 @@ Agent::Action MyAI::getAction( int number )
         for (int i = leftCoveredX; i <= colDimension; i++) {
             for (int j = leftCoveredY; j <= rowDimension; j++) {
                     
-                if (effectiveLabels[i][j] == -2) {
+                if (peekLabel(i * labelStride + j) == -2) {
                     leftCoveredX = i;
                     leftCoveredY = j;
                     flagCount++;
@@ -99,7 +261,9 @@ Agent::Action MyAI::getAction( int number )
                     agentX = i;
                     agentY = j;
 
-                    return {FLAG, i - 1, j - 1};
+                    lastDecision = SWEEP_FLAG;
+                    next = {FLAG, i - 1, j - 1};
+                    return true;
                 }
 
                 if (j == rowDimension) {
@@ -109,34 +273,32 @@ Agent::Action MyAI::getAction( int number )
         }
 
         if (flagCount == totalMines) {
-            return {LEAVE, 0, 0};
+            lastDecision = LEAVE_GAME;
+            next = {LEAVE, 0, 0};
+            return true;
         }
     }
 
+    return false;
+}
 
-    // If model checking says that there is a sure mine tile still covered, FLAG all
-    if (mineCoveredFrontierTile.size() > 0) {
-        
-        std::pair<int, int> current = mineCoveredFrontierTile.front();
-        mineCoveredFrontierTile.pop();
-        agentX = current.first;
-        agentY = current.second;
-        flagCount++;
-        coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, current));
-        effectiveLabels[current.first][current.second] = -3;
-        return {FLAG, current.first - 1, current.second - 1};
+Agent::Action MyAI::decideAction( int number )
+{    
+    // If number = -1, skip
+    if (number != -1) {
+        applyPercept(agentX, agentY, number);
     }
 
-    // If model checking says that there is a sure safe tile still covered, UNCOVER all
-    if (safeCoveredFrontierTile.size() > 0) {
-        std::pair<int, int> current = safeCoveredFrontierTile.front();
-        safeCoveredFrontierTile.pop();
-        agentX = current.first;
-        agentY = current.second;
-        uncoverCount++;
-        updateEffectiveLabels(current.first, current.second);
-        coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, current));
-        return {UNCOVER, current.first - 1, current.second - 1};
+    // If all mines are FLAGGED, UNCOVER the rest; if all safe tiles are UNCOVERED, FLAG the rest
+    Action swept;
+    if (sweep(swept)) {
+        return swept;
+    }
+
+    // Continue a plan made by an earlier call (zero opening or model checking result)
+    Action planned;
+    if (resumePlan(planned)) {
+        return planned;
     }
 
     while (true) {
@@ -145,20 +307,7 @@ Agent::Action MyAI::getAction( int number )
 
 
             // If PQ is empty, we can only guess. Make a random moves by uncovering one of the remaining covered tiles.
-            std::pair<int, int> randomCoveredTiles = getRandomCoveredTile();
-
-            updateEffectiveLabels(randomCoveredTiles.first, randomCoveredTiles.second);
-            agentX = randomCoveredTiles.first;
-            agentY = randomCoveredTiles.second;
-            uncoverCount++;
-
-            // If the randomized tile exist in the coveredFrontier, erase it.
-            int randomIndex = findInVector(coveredFrontier, randomCoveredTiles);
-            if (randomIndex != -1) {
-                coveredFrontier.erase(coveredFrontier.begin() + randomIndex);
-            }
-
-            return {UNCOVER, randomCoveredTiles.first - 1, randomCoveredTiles.second - 1};
+            return uncoverTile(getRandomCoveredTile(), RANDOM_COVERED);
 
         }
 
@@ -178,34 +327,14 @@ Agent::Action MyAI::getAction( int number )
             // Safe option found, if pqUpdate was update in the last action, reset to false.
             pqUpdate = false;
 
-            std::pair<int, int> safeN = getCoveredNeighbor(minEffLabel.tileX, minEffLabel.tileY);
-
-            // If there is an uncovered neighbor left, aka. (x, y) > (0, 0)
-            if (safeN.first != 0 && safeN.second != 0) {
-
-                // If there is only 1 covered neighbors left, remove from pq because next action will UNCOVER it.
-                if (getNumNeighborCovered(minEffLabel.tileX, minEffLabel.tileY) == 1) {
-                    pq.pop();
-                }
-
-                agentX = safeN.first;
-                agentY = safeN.second;
-                uncoverCount++;
-                updateEffectiveLabels(safeN.first, safeN.second);
-
-                int safeIndex = findInVector(coveredFrontier, safeN);
-                if (safeIndex != -1) {
-                    coveredFrontier.erase(coveredFrontier.begin() + safeIndex);
-                }
-
-                return {UNCOVER, safeN.first - 1, safeN.second - 1};
-
-            } else {
-                    
-                // Else: There is no more covered neighbor
-                // Pop this tile from the PQ. Go back to while(true) loop to find the suitable action
-                pq.pop();
+            // Every covered neighbor is safe: plan all of them and pop the tile, the plan
+            // carries the remaining moves so the PQ is not revisited for this tile.
+            pq.pop();
+            planOpening(minEffLabel.tileX, minEffLabel.tileY, PQ_SAFE);
 
+            Action safeMove;
+            if (resumePlan(safeMove)) {
+                return safeMove;
             }
 
         } else if (minEffLabel.number == 0) {
@@ -216,36 +345,21 @@ Agent::Action MyAI::getAction( int number )
             pqUpdate = false;
 
             // A tile with number != 0 but number = remaining covered tile (aka. all neighbors are tiles)
-            // FLAG
-            std::pair<int, int> mineTile = getCoveredNeighbor(minEffLabel.tileX, minEffLabel.tileY);            
-
-            // If there is an uncovered neighbor left, aka. (x, y) > (0, 0)
-            if (mineTile.first != 0 && mineTile.second != 0) {
-                
-                if (getNumNeighborCovered(minEffLabel.tileX, minEffLabel.tileY) == 1) {
-                    pq.pop();
-                }
-
-                flagCount++;
-
-                // -3 means FLAGGED
-                effectiveLabels[mineTile.first][mineTile.second] = -3;
-
-                int mineIndex = findInVector(coveredFrontier, mineTile);
-                if (mineIndex != -1) {
-                    coveredFrontier.erase(coveredFrontier.begin() + mineIndex);
+            // FLAG all of them through the plan
+            pq.pop();
+            std::queue<std::pair<int, int>> mineTiles = getAllCoveredNeighbors(minEffLabel.tileX, minEffLabel.tileY);
+            while (mineTiles.empty() != true) {
+                if (existInPlan(mineTiles.front().first, mineTiles.front().second) != true) {
+                    planMove(plannedMove{FLAG, mineTiles.front().first, mineTiles.front().second, PQ_MINE});
                 }
+                mineTiles.pop();
+            }
 
-                return {FLAG, mineTile.first - 1, mineTile.second - 1};
-
-            } else {
-
-                // Else: all neighbor tiles are UNCOVERED
-                // Pop from PQ and return to while(true) loop to find the suitable action
-                pq.pop();
-                    
+            Action mineMove;
+            if (resumePlan(mineMove)) {
+                return mineMove;
             }
-            
+
         } else {
 
             // There is a mine, and there are more tiles to be uncovered than the mine numbers.
@@ -258,34 +372,9 @@ Agent::Action MyAI::getAction( int number )
                 pqUpdate = true;
             
 
-                    //std::cout << "more tiles to be uncovered than the mine numbers -- REFRESH" << std::endl;
-
-                    // A queue use to temporarily store tiles in PQ, for restoring PQ after opration is done.
-                    std::priority_queue<usingTile, vector<usingTile>, compareNumber> tempQueue;
-
-                    // Update number (according to EffectiveLabel) for all tiles in PQ
-                    while (pq.empty() != true) {
-                        usingTile tempTile = pq.top();
-                        pq.pop();
-
-                        // Replace number by effectiveLabel
-                        if (tempTile.number != effectiveLabels[tempTile.tileX][tempTile.tileY]) {
-                            tempTile.number = effectiveLabels[tempTile.tileX][tempTile.tileY];
-                        }
-                        
-                        // If updated number is equal to the # of covered neighbors, then all neighbor is safe.
-                        // Set this tile's number to -1.
-                        if (tempTile.number == getNumNeighborCovered(tempTile.tileX, tempTile.tileY)) {
-                            tempTile.number = -1;
-                        }
-                        
-                        if (tempTile.number >= -1) {
-                            tempQueue.push(tempTile);
-                        }
-                    }
-
-                    // Restore PQ
-                    pq = tempQueue;
+                //std::cout << "more tiles to be uncovered than the mine numbers -- REFRESH" << std::endl;
+                refreshPQ(pq);
+                MYAI_STAT(callCost.refreshes++);
 
             } else {
 
@@ -297,148 +386,57 @@ Agent::Action MyAI::getAction( int number )
                 passedAssignments.clear();
                 coveredFrontier.clear();
 
-                // A copy of PQ, act as uncoveredFrontier
-                std::vector<usingTile> uncoveredFrontierVector;
+                frontierSnapshot frontier = buildFrontier(pq);
+                coveredFrontier = frontier.covered;
+                MYAI_STAT(callCost.frontierTiles += frontier.covered.size());
 
-                /*
-                    Get all uncovered frontier.
-                    If this is the first time using the frontier, coveredFrontier starts out empty.
-                    If this is not the first time, more frontier tiles will be added into coveredFrontier.
-                    coveredFrontier's size will exceed 10 tiles, but not by much, to minimize computation time.
-                */
-                while (pq.empty() != true && coveredFrontier.size() < 10) {
-                    usingTile temp = pq.top();
+                // A background worker may already have solved exactly this frontier while the
+                // World was applying the previous move; otherwise enumerate it here.
+                if (takeSpeculation(frontier, passedAssignments) != true) {
 
-                    std::queue<std::pair<int, int>> coveredNeighborList = getAllCoveredNeighbors(temp.tileX, temp.tileY);
-                    while (coveredNeighborList.empty() != true) {
+                    if (portfolioMode) {
 
-                        // If the covered tile is not already in coveredFrontier, push it into the vector.
-                        if (findInVector(coveredFrontier, coveredNeighborList.front()) == -1) {
-                            coveredFrontier.push_back(coveredNeighborList.front()); 
+                        // Race the strategies; only enumeration hands back full assignments; the
+                        // others answer with forced tiles or mine probabilities directly.
+                        frontierVerdict verdict = solvePortfolio(frontier);
+                        if (verdict.strategy != ENUMERATION) {
+                            pqUpdate = false;
+                            return actOnVerdict(verdict);
                         }
-                        coveredNeighborList.pop();
+                        passedAssignments = verdict.assignments;
+                        MYAI_STAT(callCost.rows += verdict.cost.rows);
+                        MYAI_STAT(callCost.constraints += verdict.cost.constraints);
 
+                    } else {
+                        // Over its time budget, enumeration stops and the move falls back to a guess
+                        solveCost cost;
+                        passedAssignments = enumerateAssignments(frontier, stop, &cost);
+                        MYAI_STAT(callCost.rows += cost.rows);
+                        MYAI_STAT(callCost.constraints += cost.constraints);
                     }
-                    pq.pop();
-                    uncoveredFrontierVector.push_back(temp);
-
                 }
 
+                if (passedAssignments.size() == 1) {
 
-                // Restore PQ
-                for (usingTile t : uncoveredFrontierVector) {
-                    pq.push(t);
-                }
-                    
-                int coverFrontierSize = coveredFrontier.size();
-                int uncoveredFrontierVectorSize = uncoveredFrontierVector.size();
-                    
-
-                /*
-                    Simulating each possible situation the covered frontier can be.
-                    Each column of truthTableRow represent each tile in coveredFrontier.
-                    Index of truthTable = Index of coveredFrontier
-                    Assign 0 or 1 to each column to indicate safe or mine.
-                */
-                int i = 1;
-                truthTableRow = 0;
-
-                /*  
-                    1. The do-while loop is responsible for incrementing truthTableRow by 1 to generate all possible
-                       safe tiles and mine tiles placement in coveredFrontier
-                    2. The do-while loop runs 2^(size of coveredFrontier) times to simulate all possibe assignment of all
-                       tiles in coveredFrontier
-                */
-                do {
-
-                    // numConstraintPassed is the number of uncoveredFrontier tiles that are satisfied by the assignment.
-                    
-                    int numConstraintPassed = 0;
-
-                    // Check against each EF in frontier sets (constraints). If pass, record.
-                    /*
-                        For each uncovered frontier:
-                            Find all covered neighbor (which is in the 10 covered frontier list)
-                            For each covered neighbor:
-                                Look up the safe tiles and mine tiles assignment for the current truthTableRow.
-                                Sum it up.
-                            Check if the sum of all mines in neighbors = # of covered neighbor - effectiveLabel.
-                    */
-                    for (usingTile t : uncoveredFrontierVector) {
-
-                        int sum = 0;
-                        // Find all the covered neighbor of the current uncovered frontier tile
-                        std::queue<std::pair<int, int>> adj = getAllCoveredNeighbors(t.tileX, t.tileY);
-                            
-                        // 
-                        while (adj.empty() != true) {
-                            int index = findInVector(coveredFrontier, adj.front());
-                            if (index != -1) {
-                                // Sum from bitset
-                                sum += truthTableRow[index];
-                            }
-                            adj.pop();
-                        }
-                            
-                        // If sum of the 1's from neighboring covered tiles == the mine left, pass 1 constraint.
-                        if (sum == 0 && effectiveLabels[t.tileX][t.tileY] == -1) {
-                            numConstraintPassed++;
-                        } else if (sum == getNumNeighborCovered(t.tileX, t.tileY) - effectiveLabels[t.tileX][t.tileY]) {
-                            numConstraintPassed++;
+                    // Only one assignment fits: every covered frontier tile is decided. Plan the mines
+                    // first, then the safe tiles, and let the following calls resume the plan.
+                    for (int i = 0; i < coveredFrontier.size(); i++) {
+                        if (passedAssignments[0][i] == 1) {
+                            planMove(plannedMove{FLAG, coveredFrontier[i].first, coveredFrontier[i].second, UNIQUE_ASSIGNMENT});
                         }
                     }
-
-                    // If the current assignment corresponds with effectiveLabels of every tiles in uncovered frontier,
-                    // then it is a solution.
-                    if (numConstraintPassed == uncoveredFrontierVectorSize) {
-                        passedAssignments.push_back(truthTableRow);
-                    }
-
-                    unsigned long l = truthTableRow.to_ulong() + 1;
-                    truthTableRow = (int)(l);
-                    i++;
-
-
-                } while (i <= std::pow(2, coverFrontierSize));
-
-                    
-
-                if (passedAssignments.size() == 1) {
-                    
                     for (int i = 0; i < coveredFrontier.size(); i++) {
-                            
                         if (passedAssignments[0][i] == 0) {
-                            safeCoveredFrontierTile.push(coveredFrontier[i]);
-                        } else if (passedAssignments[0][i] == 1) {
-                            mineCoveredFrontierTile.push(coveredFrontier[i]);
+                            planMove(plannedMove{UNCOVER, coveredFrontier[i].first, coveredFrontier[i].second, UNIQUE_ASSIGNMENT});
                         }
                     }
 
-
-                    if (mineCoveredFrontierTile.size() > 0) {
-
-                        std::pair<int, int> current = mineCoveredFrontierTile.front();
-                        mineCoveredFrontierTile.pop();
-                        agentX = current.first;
-                        agentY = current.second;
-                        flagCount++;
-                        coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, current));
-                        pqUpdate = false;
-                        effectiveLabels[current.first][current.second] = -3;
-                        return {FLAG, current.first - 1, current.second - 1};
-
-                    } else {
-
-                        std::pair<int, int> current = safeCoveredFrontierTile.front();
-                        safeCoveredFrontierTile.pop();
-                        agentX = current.first;
-                        agentY = current.second;
-                        uncoverCount++;
-                        updateEffectiveLabels(current.first, current.second);
-                        coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, current));
-                        pqUpdate = false;
-                        return {UNCOVER, current.first - 1, current.second - 1};
+                    pqUpdate = false;
+                    Action uniqueMove;
+                    if (resumePlan(uniqueMove)) {
+                        return uniqueMove;
                     }
+                    return uncoverTile(getRandomCoveredTile(), RANDOM_COVERED);
 
                 } else {
 
@@ -448,15 +446,16 @@ Agent::Action MyAI::getAction( int number )
 
                     if (successSize > 0) {
 
-                            // Get all covered tile in frontier that is not a mine --> safeCoveredFrontierTile
+                            // Get all covered tile in frontier that is not a mine --> plan
                         /*
                             Compare the index i of each successful assignments to the index i of the first successful assignment
                             Break as soon as a mismatch is found.
-                            If there is a consistent index in all successful assignments, add to:
-                                mineCoveredFrontierTile if 1
-                                safeCoveredFrontierTile if 0
-                            If no consistency is found, mineCoveredFrontierTile and mineCoveredFrontierTile have size 0.
+                            If there is a consistent index in all successful assignments, plan:
+                                a FLAG if 1
+                                an UNCOVER if 0
+                            Mines are planned before safe tiles. If no consistency is found, the plan stays empty.
                         */
+                        std::vector<std::pair<int, int>> consistentSafe;
                         for (int bitIndex = 0; bitIndex < coveredFrontier.size(); bitIndex++) {
                             bool sameBit = true;
                             int bit = passedAssignments[0][bitIndex];
@@ -469,92 +468,54 @@ Agent::Action MyAI::getAction( int number )
                             }
 
                             if (sameBit == true && bit == 0) {
-                                std::pair<int, int> safeTile = coveredFrontier[bitIndex];
-                                if (existInQueue(safeCoveredFrontierTile, safeTile) != true) {
-                                    safeCoveredFrontierTile.push(safeTile);
-                                }
+                                consistentSafe.push_back(coveredFrontier[bitIndex]);
                             } else if (sameBit == true && bit == 1) {
-                                std::pair<int, int> nsafeTile = coveredFrontier[bitIndex];
-                                if (existInQueue(mineCoveredFrontierTile, nsafeTile) != true) {
-                                    mineCoveredFrontierTile.push(nsafeTile);
-                                }
+                                planMove(plannedMove{FLAG, coveredFrontier[bitIndex].first, coveredFrontier[bitIndex].second, CONSISTENT_BIT});
                             }
 
                         }
+                        for (std::pair<int, int> safeTile : consistentSafe) {
+                            planMove(plannedMove{UNCOVER, safeTile.first, safeTile.second, CONSISTENT_BIT});
+                        }
 
- 
-                        if (mineCoveredFrontierTile.size() > 0) {
+                        if (plan.empty() != true) {
 
-                            std::pair<int, int> current = mineCoveredFrontierTile.front();
-                            mineCoveredFrontierTile.pop();
-                            agentX = current.first;
-                            agentY = current.second;
-                            flagCount++;
-                            coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, current));
+                            // There is a sure mine tile or a sure safe tile!
                             pqUpdate = false;
-                            effectiveLabels[current.first][current.second] = -3;
-                            return {FLAG, current.first - 1, current.second - 1};
+                            Action consistentMove;
+                            if (resumePlan(consistentMove)) {
+                                return consistentMove;
+                            }
                         }
 
-                        if (safeCoveredFrontierTile.size() == 0) {
-
-                            /*
-                                For each tiles in coveredFrontier:
-                                    Count how many of the successful assignments the tile is a mine (1)
-                                Compute the probability of the tile being a mine --> P(mine) = assignment count / total successful assignment
+                        /*
+                            For each tiles in coveredFrontier:
+                                Count how many of the successful assignments the tile is a mine (1)
+                            Compute the probability of the tile being a mine --> P(mine) = assignment count / total successful assignment
 
-                            */
-                            for (int bitIndex = 0; bitIndex < coveredFrontier.size(); bitIndex++) {
-                                int countMineProb = 0;
+                        */
+                        for (int bitIndex = 0; bitIndex < coveredFrontier.size(); bitIndex++) {
+                            int countMineProb = 0;
 
-                                for (int assignmentIndex = 0; assignmentIndex < passedAssignments.size(); assignmentIndex++) {
-                                    if (passedAssignments[assignmentIndex][bitIndex] == 1) {
-                                        countMineProb++;
-                                    }
+                            for (int assignmentIndex = 0; assignmentIndex < passedAssignments.size(); assignmentIndex++) {
+                                if (passedAssignments[assignmentIndex][bitIndex] == 1) {
+                                    countMineProb++;
                                 }
-
-                                maxProb.push(tileProb{coveredFrontier[bitIndex].first, coveredFrontier[bitIndex].second, (double)countMineProb / (double)(passedAssignments.size())});
-                                    
                             }
 
+                            maxProb.push(tileProb{coveredFrontier[bitIndex].first, coveredFrontier[bitIndex].second, (double)countMineProb / (double)(passedAssignments.size())});
 
-                            tileProb current = maxProb.top();
-                            maxProb.pop();
-                            agentX = current.tileX;
-                            agentY = current.tileY;
-                            flagCount++;
-                            std::pair<int, int> p {current.tileX, current.tileY};
-                            coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, p));
-                            pqUpdate = false;
-                            effectiveLabels[current.tileX][current.tileY] = -3;
-                            return {FLAG, current.tileX - 1, current.tileY - 1};
-
-                                
-                        } else {
-
-                            // There is no sure mine tile, but there is a sure safe tile!
-                            std::pair<int, int> notMine = safeCoveredFrontierTile.front();
-                            safeCoveredFrontierTile.pop();
-                            agentX = notMine.first;
-                            agentY = notMine.second;
-                            uncoverCount++;
-                            updateEffectiveLabels(notMine.first, notMine.second);
-                            pqUpdate = false;
-                            coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, notMine));
-                            return {UNCOVER, notMine.first - 1, notMine.second - 1};
-                    
                         }
 
+
+                        tileProb current = maxProb.top();
+                        pqUpdate = false;
+                        return flagTile(std::pair<int, int>{current.tileX, current.tileY}, MAX_PROBABILITY_FLAG);
+
                     } else {
 
-                        std::pair<int, int> guessTile = getRandomCoveredFrontierTile();
-                        agentX = guessTile.first;
-                        agentY = guessTile.second;
-                        uncoverCount++;
-                        updateEffectiveLabels(guessTile.first, guessTile.second);
-                        coveredFrontier.erase(coveredFrontier.begin() + findInVector(coveredFrontier, guessTile));
                         pqUpdate = false;
-                        return {UNCOVER, guessTile.first - 1, guessTile.second - 1};      
+                        return uncoverTile(getRandomCoveredFrontierTile(), RANDOM_FRONTIER);
 
                     }
 
@@ -568,143 +529,900 @@ Agent::Action MyAI::getAction( int number )
 }
 
 
-int MyAI::getNumNeighborCovered(int x, int y) {
-    
+void MyAI::refreshPQ(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue) {
+
+    // A queue use to temporarily store tiles in PQ, for restoring PQ after opration is done.
+    std::priority_queue<usingTile, vector<usingTile>, compareNumber> tempQueue;
+
+    // Update number (according to EffectiveLabel) for all tiles in PQ
+    while (queue.empty() != true) {
+        usingTile tempTile = queue.top();
+        queue.pop();
+
+        // Replace number by effectiveLabel
+        if (tempTile.number != label(tempTile.tileX, tempTile.tileY)) {
+            tempTile.number = label(tempTile.tileX, tempTile.tileY);
+        }
+
+        // If updated number is equal to the # of covered neighbors, then all neighbor is safe.
+        // Set this tile's number to -1.
+        if (tempTile.number == getNumNeighborCovered(tempTile.tileX, tempTile.tileY)) {
+            tempTile.number = -1;
+        }
+
+        if (tempTile.number >= -1) {
+            tempQueue.push(tempTile);
+        }
+    }
 
-    int counter = 0;
+    // Restore PQ
+    queue = tempQueue;
 
-    for (unsigned int i = x - 1; i <= x + 1; i++) {
-        if (i <= colDimension && i > 0 && y != 1) 
-        {
-            if (effectiveLabels[i][y - 1] == -2) {
-                counter++;
+}
+
+
+MyAI::frontierSnapshot MyAI::buildFrontier(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue) {
+
+    frontierSnapshot frontier;
+
+    // A copy of PQ, act as uncoveredFrontier
+    std::vector<usingTile> uncoveredFrontierVector;
+
+    /*
+        Get all uncovered frontier.
+        coveredFrontier's size will exceed 10 tiles, but not by much, to minimize computation time.
+    */
+    while (queue.empty() != true && frontier.covered.size() < 10) {
+        usingTile temp = queue.top();
+
+        std::queue<std::pair<int, int>> coveredNeighborList = getAllCoveredNeighbors(temp.tileX, temp.tileY);
+        while (coveredNeighborList.empty() != true) {
+
+            // If the covered tile is not already in coveredFrontier, push it into the vector.
+            if (findInVector(frontier.covered, coveredNeighborList.front()) == -1) {
+                frontier.covered.push_back(coveredNeighborList.front());
             }
+            coveredNeighborList.pop();
+
         }
-        if (i <= colDimension && i > 0 && y < rowDimension)
-        {
-            if (effectiveLabels[i][y + 1] == -2) {
-                counter++;
+        queue.pop();
+        uncoveredFrontierVector.push_back(temp);
+
+    }
+
+    // Restore PQ
+    for (usingTile t : uncoveredFrontierVector) {
+        queue.push(t);
+    }
+
+    /*
+        Each uncovered frontier tile becomes one constraint:
+            The indices (into the covered frontier) of its covered neighbors.
+            The number of mines an assignment must place on them = # of covered neighbor - effectiveLabel,
+            or 0 when every neighbor is safe (effectiveLabel = -1).
+    */
+    for (usingTile t : uncoveredFrontierVector) {
+
+        frontierConstraint constraint;
+        std::queue<std::pair<int, int>> adj = getAllCoveredNeighbors(t.tileX, t.tileY);
+        while (adj.empty() != true) {
+            int index = findInVector(frontier.covered, adj.front());
+            if (index != -1) {
+                constraint.coveredIndex.push_back(index);
             }
+            adj.pop();
+        }
+
+        if (label(t.tileX, t.tileY) == -1) {
+            constraint.mines = 0;
+        } else {
+            constraint.mines = getNumNeighborCovered(t.tileX, t.tileY) - label(t.tileX, t.tileY);
         }
+
+        frontier.constraints.push_back(constraint);
     }
-    if (x <= colDimension && x > 1 && effectiveLabels[x - 1][y] == -2) {
-        counter++;
+
+    return frontier;
+
+}
+
+
+std::vector<std::bitset<20>> MyAI::enumerateAssignments(const frontierSnapshot& frontier, const std::atomic<bool>* cancel, solveCost* cost) {
+
+    std::vector<std::bitset<20>> passed;
+    unsigned long rowsChecked = 0;
+    unsigned long constraintsChecked = 0;
+
+    /*
+        Simulating each possible situation the covered frontier can be.
+        Each column of truthTableRow represent each tile in the covered frontier.
+        Assign 0 or 1 to each column to indicate safe or mine.
+        The loop runs 2^(size of covered frontier) times to simulate all possibe assignment.
+    */
+    unsigned long rows = 1UL << frontier.covered.size();
+    for (unsigned long row = 0; row < rows; row++) {
+
+        // A speculative solve whose frontier was not reached, a portfolio race that was
+        // already won, or a game over its time budget gets cancelled; stop early.
+        if (cancel != NULL && (row & 1023) == 0 && cancel->load(std::memory_order_relaxed)) {
+            passed.clear();
+            break;
+        }
+
+        rowsChecked++;
+
+        std::bitset<20> truthTableRow(row);
+
+        // If the current assignment satisfies every constraint, then it is a solution.
+        bool passedAll = true;
+        for (const frontierConstraint& constraint : frontier.constraints) {
+            int sum = 0;
+            for (int index : constraint.coveredIndex) {
+                sum += truthTableRow[index];
+            }
+            constraintsChecked++;
+            if (sum != constraint.mines) {
+                passedAll = false;
+                break;
+            }
+        }
+
+        if (passedAll) {
+            passed.push_back(truthTableRow);
+        }
     }
-    if (x < colDimension && x >= 1 && effectiveLabels[x + 1][y] == -2) {
-        counter++;
+
+    if (cost != NULL) {
+        cost->rows = rowsChecked;
+        cost->constraints = constraintsChecked;
     }
+    return passed;
+
+}
+
+
+void MyAI::speculateAfter(Action move) {
+
+    // Start over: whatever was speculated for the previous move is stale now
+    cancelSpeculations();
+
+    // The next call resumes the plan or sweeps the board, there is no frontier to solve
+    if (plan.empty() != true || sweepReady()) {
+        return;
+    }
+
+    int x = move.x + 1;
+    int y = move.y + 1;
+
+    if (move.action == FLAG) {
 
-    return counter;
+        // A FLAG always comes back with percept -1: the next state is the current one
+        speculate(x, y, -1);
+
+    } else if (move.action == UNCOVER) {
+
+        // The percept lies between the flagged neighbors and flagged + covered neighbors.
+        // A zero only extends the plan, so it needs no solving.
+        int minNumber = std::max(getNumFlagNeighbor(x, y), 1);
+        int maxNumber = getNumFlagNeighbor(x, y) + getNumNeighborCovered(x, y);
+
+        if (maxNumber - minNumber + 1 > maxSpeculativeOutcomes) {
+            return;
+        }
+
+        for (int number = minNumber; number <= maxNumber; number++) {
+            speculate(x, y, number);
+        }
+    }
 
 }
 
 
-std::pair<int, int> MyAI::getCoveredNeighbor(int x, int y) {
+void MyAI::speculate(int x, int y, int number) {
 
-    std::pair<int, int> safeNeighbor;
-    safeNeighbor.first = 0;
-    safeNeighbor.second = 0;
+    // Replay the percept on a copy of the PQ; the label is restored right after.
+    std::priority_queue<usingTile, vector<usingTile>, compareNumber> predicted = pq;
+    if (number > 0) {
+        int predictedLabel = getNumNeighborCovered(x, y) - (number - getNumFlagNeighbor(x, y));
+        label(x, y) = predictedLabel;
+        predicted.push(usingTile{x, y, predictedLabel});
+    }
+
+    frontierSnapshot frontier;
+    bool reachesModelChecking = predictFrontier(predicted, frontier);
+
+    if (number > 0) {
+        label(x, y) = -2;
+    }
 
+    // Small frontiers are cheaper to solve in place than to hand to a worker
+    if (reachesModelChecking != true || frontier.covered.size() < minSpeculativeFrontier) {
+        return;
+    }
+
+    speculation s;
+    s.frontier = frontier;
+    s.cancel = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> cancel = s.cancel;
+    s.result = std::async(std::launch::async, [frontier, cancel]() {
+        return enumerateAssignments(frontier, cancel.get(), NULL);
+    });
+    speculations.push_back(std::move(s));
+    speculativeSolves++;
+
+}
+
+
+bool MyAI::predictFrontier(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue, frontierSnapshot& frontier) {
+
+    // Mirrors the PQ loop of decideAction without making a move
+    bool refreshed = pqUpdate;
+
+    while (true) {
+
+        // The next call guesses
+        if (queue.empty() == true) {
+            return false;
+        }
+
+        usingTile top = queue.top();
+        if (top.number == -1 || top.number == 0) {
+
+            // The next call plans these neighbors instead of model checking
+            if (getNumNeighborCovered(top.tileX, top.tileY) > 0) {
+                return false;
+            }
+            refreshed = false;
+            queue.pop();
+
+        } else if (refreshed != true) {
 
-    if (x - 1 >= 1 && y - 1 >= 1 && effectiveLabels[x - 1][y - 1] == -2) {
-        safeNeighbor.first = x - 1;
-        safeNeighbor.second = y - 1;
-        
-    } else if (y - 1 >= 1 && effectiveLabels[x][y - 1] == -2) {
-        safeNeighbor.first = x;
-        safeNeighbor.second = y - 1;
-        
-    } else if (x + 1 <= colDimension && y - 1 >= 1 && effectiveLabels[x + 1][y - 1] == -2) {
-        safeNeighbor.first = x + 1;
-        safeNeighbor.second = y - 1;
+            refreshPQ(queue);
+            refreshed = true;
 
-    } else if (x - 1 >= 1 && y + 1 <= rowDimension && effectiveLabels[x - 1][y + 1] == -2) {
-        safeNeighbor.first = x - 1;
-        safeNeighbor.second = y + 1;
+        } else {
+
+            frontier = buildFrontier(queue);
+            return true;
+
+        }
+    }
+
+}
 
-    } else if (y + 1 <= rowDimension && effectiveLabels[x][y + 1] == -2) {
-        safeNeighbor.first = x;
-        safeNeighbor.second = y + 1;
 
-    } else if (x + 1 <= colDimension && y + 1 <= rowDimension && effectiveLabels[x + 1][y + 1] == -2) {
-        safeNeighbor.first = x + 1;
-        safeNeighbor.second = y + 1;
+bool MyAI::takeSpeculation(const frontierSnapshot& frontier, std::vector<std::bitset<20>>& assignments) {
 
-    } else if (x - 1 >= 1 && effectiveLabels[x - 1][y] == -2) {
-        safeNeighbor.first = x - 1;
-        safeNeighbor.second = y;
+    bool found = false;
 
-    } else if (x + 1 <= colDimension && effectiveLabels[x + 1][y] == -2) {
-        safeNeighbor.first = x + 1;
-        safeNeighbor.second = y;
+    for (speculation& s : speculations) {
+        if (found != true && s.frontier == frontier) {
+            assignments = s.result.get();
+            found = true;
+            speculativeHits++;
+        } else {
+            s.cancel->store(true);
+        }
     }
 
-    return safeNeighbor;
+    // Waits for the cancelled workers, which stop within a few rows
+    speculations.clear();
+    return found;
 
 }
 
 
-int MyAI::getNumFlagNeighbor(int x, int y) {
+void MyAI::cancelSpeculations() {
+
+    for (speculation& s : speculations) {
+        s.cancel->store(true);
+    }
+    speculations.clear();
+
+}
+
+MyAI::frontierVerdict MyAI::solvePortfolio(const frontierSnapshot& frontier) {
+
+    // Shared between the strategies; the first definitive verdict wins and cancels the rest
+    struct race {
+        std::mutex lock;
+        std::condition_variable finished;
+        std::atomic<bool> cancel;
+        int winner;
+        int done;
+        frontierVerdict verdicts[PORTFOLIO_STRATEGIES];
+        std::chrono::steady_clock::time_point wonAt;
+    } r;
+    r.cancel.store(false);
+    r.winner = -1;
+    r.done = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned int samplingSeed = engine();
+
+    auto report = [&r](frontierVerdict verdict) {
+        std::lock_guard<std::mutex> guard(r.lock);
+        int strategy = verdict.strategy;
+        if (verdict.definitive && r.winner == -1) {
+            r.winner = strategy;
+            r.wonAt = std::chrono::steady_clock::now();
+            r.cancel.store(true);
+        }
+        r.verdicts[strategy] = std::move(verdict);
+        r.done++;
+        r.finished.notify_one();
+    };
+
+    std::future<void> workers[PORTFOLIO_STRATEGIES] = {
+        std::async(std::launch::async, [&]() { report(propagateRules(frontier)); }),
+        std::async(std::launch::async, [&]() {
+            frontierVerdict verdict;
+            verdict.strategy = ENUMERATION;
+            verdict.assignments = enumerateAssignments(frontier, &r.cancel, &verdict.cost);
+            verdict.definitive = verdict.cost.rows == (1UL << frontier.covered.size());
+            report(std::move(verdict));
+        }),
+        std::async(std::launch::async, [&]() { report(sampleAssignments(frontier, samplingSeed, &r.cancel)); })
+    };
+
+    // Over its time budget the race ends with no winner: the workers see r.cancel below,
+    // enumeration hands back nothing, and the move falls back to a guess
+    {
+        std::unique_lock<std::mutex> guard(r.lock);
+        while (r.finished.wait_for(guard, std::chrono::milliseconds(1),
+                                   [&r]() { return r.winner != -1 || r.done == PORTFOLIO_STRATEGIES; }) != true) {
+            if (stop != nullptr && stop->load(std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+
+    // Cooperative cancellation: the losers poll r.cancel and return shortly
+    r.cancel.store(true);
+    for (std::future<void>& worker : workers) {
+        worker.get();
+    }
+
+    // Enumeration never loses a race it finishes, so a missing winner only comes from the
+    // time budget; fall back to its (then empty) verdict.
+    int winner = r.winner == -1 ? ENUMERATION : r.winner;
+    portfolioWins[winner]++;
+
+    // Estimate what enumeration alone would have cost from the share of rows it got through
+    if (winner != ENUMERATION && r.verdicts[ENUMERATION].cost.rows > 0) {
+        double enumerated = (double)r.verdicts[ENUMERATION].cost.rows / (double)(1UL << frontier.covered.size());
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        double won = std::chrono::duration<double, std::micro>(r.wonAt - start).count();
+        if (elapsed / enumerated > won) {
+            portfolioSavedMicros += (long)(elapsed / enumerated - won);
+        }
+    }
+
+    return r.verdicts[winner];
+
+}
 
-    int counter = 0;
 
-    for (unsigned int i = x - 1; i <= x + 1; i++) {
-        if (i <= colDimension && i > 0 && y != 1) 
-        {
-            if (effectiveLabels[i][y - 1] == -3) {
-                counter++;
+MyAI::frontierVerdict MyAI::propagateRules(const frontierSnapshot& frontier) {
+
+    frontierVerdict verdict;
+    verdict.strategy = RULE_PROPAGATION;
+
+    // -1 unknown, 0 safe, 1 mine
+    std::vector<int> known(frontier.covered.size(), -1);
+
+    /*
+        Repeat until nothing changes:
+            A constraint with no mines left makes its unknown tiles safe.
+            A constraint with as many mines left as unknown tiles makes them all mines.
+            If the unknown tiles of A are a subset of those of B, the difference holds
+            (mines left in B - mines left in A) mines: apply the same two rules to it.
+    */
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        std::vector<std::vector<int>> unknown;
+        std::vector<int> minesLeft;
+        for (const frontierConstraint& constraint : frontier.constraints) {
+            std::vector<int> u;
+            int left = constraint.mines;
+            for (int index : constraint.coveredIndex) {
+                if (known[index] == -1) {
+                    u.push_back(index);
+                } else {
+                    left -= known[index];
+                }
+            }
+            if (u.empty() != true) {
+                std::sort(u.begin(), u.end());
+                unknown.push_back(u);
+                minesLeft.push_back(left);
             }
         }
-        if (i <= colDimension && i > 0 && y < rowDimension)
-        {
-            if (effectiveLabels[i][y + 1] == -3) {
-                counter++;
+
+        for (std::size_t a = 0; a < unknown.size(); a++) {
+            for (std::size_t b = 0; b < unknown.size(); b++) {
+
+                std::vector<int> difference;
+                int differenceMines;
+
+                if (a == b) {
+                    difference = unknown[a];
+                    differenceMines = minesLeft[a];
+                } else if (std::includes(unknown[b].begin(), unknown[b].end(), unknown[a].begin(), unknown[a].end())) {
+                    std::set_difference(unknown[b].begin(), unknown[b].end(), unknown[a].begin(), unknown[a].end(), std::back_inserter(difference));
+                    differenceMines = minesLeft[b] - minesLeft[a];
+                } else {
+                    continue;
+                }
+
+                if (difference.empty() == true || (differenceMines != 0 && differenceMines != (int) difference.size())) {
+                    continue;
+                }
+
+                for (int index : difference) {
+                    if (known[index] == -1) {
+                        known[index] = differenceMines == 0 ? 0 : 1;
+                        changed = true;
+                    }
+                }
+            }
+
+            if (changed == true) {
+                break;
             }
         }
     }
-    if (x <= colDimension && x > 1 && effectiveLabels[x - 1][y] == -3) {
-        counter++;
+
+    for (std::size_t index = 0; index < known.size(); index++) {
+        if (known[index] == 1) {
+            verdict.mines.push_back(index);
+        } else if (known[index] == 0) {
+            verdict.safes.push_back(index);
+        }
     }
-    if (x < colDimension && x >= 1 && effectiveLabels[x + 1][y] == -3) {
-        counter++;
+
+    // Finding nothing proves nothing; leave the race to the other strategies
+    verdict.definitive = verdict.mines.size() + verdict.safes.size() > 0;
+    return verdict;
+
+}
+
+
+MyAI::frontierVerdict MyAI::sampleAssignments(const frontierSnapshot& frontier, unsigned int seed, const std::atomic<bool>* cancel) {
+
+    frontierVerdict verdict;
+    verdict.strategy = SAMPLING;
+
+    int size = frontier.covered.size();
+    std::minstd_rand generator(seed);
+
+    if (size == 0) {
+        return verdict;
     }
 
-    return counter;
+    // For each covered frontier tile, the constraints it takes part in
+    std::vector<std::vector<int>> involved(size);
+    for (std::size_t c = 0; c < frontier.constraints.size(); c++) {
+        for (int index : frontier.constraints[c].coveredIndex) {
+            involved[index].push_back(c);
+        }
+    }
+
+    std::vector<int> mineCount(size, 0);
+    std::vector<bool> seenSafe(size, false);
+    std::vector<bool> seenMine(size, false);
+    int samples = 0;
+
+    /*
+        Each sample is a depth-first search with a random value order, pruned as soon as
+        a constraint can no longer be met. Once every tile has been a mine in one sample
+        and safe in another, no tile can be forced: the verdict is definitive and the
+        sample frequencies stand in for the mine probabilities.
+    */
+    while (samples < maxSamples) {
+
+        if (cancel != NULL && cancel->load(std::memory_order_relaxed)) {
+            return verdict;
+        }
+
+        std::vector<int> value(size, -1);
+        std::vector<int> placed(frontier.constraints.size(), 0);
+        std::vector<int> open(frontier.constraints.size(), 0);
+        for (std::size_t c = 0; c < frontier.constraints.size(); c++) {
+            open[c] = frontier.constraints[c].coveredIndex.size();
+        }
+
+        // Explicit stack: (tile, number of values tried so far)
+        std::vector<int> firstValue(size);
+        std::vector<int> tried(size, 0);
+        int depth = 0;
+        long steps = 0;
+        while (depth >= 0 && depth < size) {
+
+            if (cancel != NULL && (++steps & 1023) == 0 && cancel->load(std::memory_order_relaxed)) {
+                return verdict;
+            }
+
+            // Undo the previous value of this tile, if any
+            if (value[depth] != -1) {
+                for (int c : involved[depth]) {
+                    placed[c] -= value[depth];
+                    open[c]++;
+                }
+                value[depth] = -1;
+            }
+
+            if (tried[depth] == 0) {
+                firstValue[depth] = generator() & 1;
+            }
+            if (tried[depth] == 2) {
+                tried[depth] = 0;
+                depth--;
+                continue;
+            }
+
+            int v = tried[depth] == 0 ? firstValue[depth] : 1 - firstValue[depth];
+            tried[depth]++;
+
+            bool feasible = true;
+            for (int c : involved[depth]) {
+                placed[c] += v;
+                open[c]--;
+                if (placed[c] > frontier.constraints[c].mines || placed[c] + open[c] < frontier.constraints[c].mines) {
+                    feasible = false;
+                }
+            }
+            value[depth] = v;
+
+            if (feasible) {
+                depth++;
+            }
+        }
+
+        // The search is complete: failing once means no assignment exists at all
+        if (depth < 0) {
+            verdict.definitive = samples == 0;
+            break;
+        }
+
+        samples++;
+        for (int index = 0; index < size; index++) {
+            mineCount[index] += value[index];
+            if (value[index] == 1) {
+                seenMine[index] = true;
+            } else {
+                seenSafe[index] = true;
+            }
+        }
+
+        bool ambiguous = true;
+        for (int index = 0; index < size; index++) {
+            if (seenMine[index] != true || seenSafe[index] != true) {
+                ambiguous = false;
+                break;
+            }
+        }
+
+        if (ambiguous) {
+            verdict.definitive = true;
+            break;
+        }
+    }
+
+    if (samples > 0) {
+        for (int index = 0; index < size; index++) {
+            verdict.mineProbability.push_back((double)mineCount[index] / (double)samples);
+        }
+    }
+    return verdict;
 
 }
 
-void MyAI::updateEffectiveLabels(int x, int y) {
 
-    if (x - 1 >= 1 && y - 1 >= 1 && effectiveLabels[x - 1][y - 1] > 0) {
-        effectiveLabels[x - 1][y - 1]--;
+Agent::Action MyAI::actOnVerdict(const frontierVerdict& verdict) {
+
+    // Forced tiles from rule propagation: mines first, then safe tiles
+    for (int index : verdict.mines) {
+        planMove(plannedMove{FLAG, coveredFrontier[index].first, coveredFrontier[index].second, PORTFOLIO_FORCED});
+    }
+    for (int index : verdict.safes) {
+        planMove(plannedMove{UNCOVER, coveredFrontier[index].first, coveredFrontier[index].second, PORTFOLIO_FORCED});
+    }
+
+    Action next;
+    if (resumePlan(next)) {
+        return next;
+    }
+
+    // Sampling: nothing is forced, FLAG the most likely mine as the exhaustive path does
+    if (verdict.mineProbability.empty() != true) {
+        int maxIndex = std::max_element(verdict.mineProbability.begin(), verdict.mineProbability.end()) - verdict.mineProbability.begin();
+        return flagTile(coveredFrontier[maxIndex], PORTFOLIO_SAMPLED_FLAG);
+    }
+
+    return uncoverTile(getRandomCoveredFrontierTile(), RANDOM_FRONTIER);
+
+}
+
+
+void MyAI::printPortfolioStats(std::ostream& out) {
+    out << "portfolio wins: rules " << portfolioWins[RULE_PROPAGATION]
+        << " enumeration " << portfolioWins[ENUMERATION]
+        << " sampling " << portfolioWins[SAMPLING] << endl;
+    out << "portfolio time saved (us): " << portfolioSavedMicros << endl;
+}
+
+
+void MyAI::printSpeculationStats(std::ostream& out) {
+    out << "speculative solves: " << speculativeSolves << " used " << speculativeHits << endl;
+}
+
+
+#ifdef MYAI_STATS
+
+void MyAI::recordDecision() {
+
+    callCost.moves = 1;
+
+    // Per agent only: the run totals are summed when they are reported
+    addDecisionStats(&gameStats[lastDecision], &callCost, 1);
+    addDecisionStats(&runStats[lastDecision], &callCost, 1);
+
+}
+
+
+void MyAI::addDecisionStats(decisionStats* into, const decisionStats* from, int types) {
+
+    for (int type = 0; type < types; type++) {
+        into[type].moves += from[type].moves;
+        into[type].rows += from[type].rows;
+        into[type].constraints += from[type].constraints;
+        into[type].frontierTiles += from[type].frontierTiles;
+        into[type].refreshes += from[type].refreshes;
+        into[type].nanos += from[type].nanos;
+    }
+
+}
+
+
+void MyAI::printDecisionStats(std::ostream& out, const decisionStats* stats) {
+
+    static const char* names[DECISION_TYPES] = {
+        "sweep uncover", "sweep flag", "leave", "zero opening", "pq safe (-1)", "pq mine (0)",
+        "unique assignment", "consistent bit", "max probability flag", "random frontier",
+        "random covered", "portfolio forced", "portfolio sampled flag"
+    };
+
+    out << "decision                moves       rows        constraints frontier    refreshes   time(us)" << endl;
+    for (int type = 0; type < DECISION_TYPES; type++) {
+        if (stats[type].moves == 0) {
+            continue;
+        }
+        out << std::left << std::setw(24) << names[type] << std::right
+            << std::setw(12) << stats[type].moves
+            << std::setw(12) << stats[type].rows
+            << std::setw(12) << stats[type].constraints
+            << std::setw(12) << stats[type].frontierTiles
+            << std::setw(12) << stats[type].refreshes
+            << std::setw(12) << stats[type].nanos / 1000 << endl;
+    }
+
+}
+
+
+void MyAI::printCorpusStats(std::ostream& out) {
+
+    // Called once the games are over, so the live agents' totals are no longer moving
+    std::lock_guard<std::mutex> guard(corpusStatsLock);
+    decisionStats total[DECISION_TYPES];
+    addDecisionStats(total, corpusStats);
+    for (const MyAI* agent : liveAgents) {
+        addDecisionStats(total, agent->runStats);
+    }
+    printDecisionStats(out, total);
+
+}
+
+#endif
+
+
+bool MyAI::resumePlan(Action& next) {
+
+    while (plan.empty() != true) {
+        plannedMove step = plan.front();
+        plan.pop_front();
+        if (--plannedTiles[step.tileX * labelStride + step.tileY] == 0) {
+            plannedTiles.erase(step.tileX * labelStride + step.tileY);
+        }
+
+        // A later percept may already have resolved this tile (uncovered through another
+        // path, or flagged). Drop the stale step instead of re-analysing the whole board.
+        if (label(step.tileX, step.tileY) != -2) {
+            continue;
+        }
+
+        if (step.action == FLAG) {
+            next = flagTile(std::pair<int, int>{step.tileX, step.tileY}, step.decision);
+        } else {
+            next = uncoverTile(std::pair<int, int>{step.tileX, step.tileY}, step.decision);
+        }
+        return true;
     }
-        
-    if (y - 1 >= 1 && effectiveLabels[x][y - 1] > 0) {
-        effectiveLabels[x][y - 1]--;
+
+    return false;
+
+}
+
+
+void MyAI::planOpening(int x, int y, decisionType decision) {
+
+    std::queue<std::pair<int, int>> safeNeighbors = getAllCoveredNeighbors(x, y);
+    while (safeNeighbors.empty() != true) {
+        if (existInPlan(safeNeighbors.front().first, safeNeighbors.front().second) != true) {
+            planMove(plannedMove{UNCOVER, safeNeighbors.front().first, safeNeighbors.front().second, decision});
+        }
+        safeNeighbors.pop();
     }
-        
-    if (x + 1 <= colDimension && y - 1 >= 1 && effectiveLabels[x + 1][y - 1] > 0) {
-        effectiveLabels[x + 1][y - 1]--;
+
+}
+
+
+bool MyAI::existInPlan(int x, int y) {
+
+    return plannedTiles.count(x * labelStride + y) != 0;
+
+}
+
+
+void MyAI::planMove(const plannedMove& step) {
+
+    plan.push_back(step);
+    plannedTiles[step.tileX * labelStride + step.tileY]++;
+
+}
+
+
+bool MyAI::isGuess(decisionType decision) {
+
+    return decision == RANDOM_FRONTIER || decision == RANDOM_COVERED
+        || decision == MAX_PROBABILITY_FLAG || decision == PORTFOLIO_SAMPLED_FLAG;
+
+}
+
+
+Agent::Action MyAI::uncoverTile(std::pair<int, int> tile, decisionType decision) {
+
+    lastDecision = decision;
+    guessCount += isGuess(decision);
+    agentX = tile.first;
+    agentY = tile.second;
+    uncoverCount++;
+    updateEffectiveLabels(tile.first, tile.second);
+    eraseFromCoveredFrontier(tile);
+    return {UNCOVER, tile.first - 1, tile.second - 1};
+
+}
+
+
+Agent::Action MyAI::flagTile(std::pair<int, int> tile, decisionType decision) {
+
+    lastDecision = decision;
+    guessCount += isGuess(decision);
+    agentX = tile.first;
+    agentY = tile.second;
+    flagCount++;
+
+    // -3 means FLAGGED
+    touchLabel(tile.first, tile.second) = -3;
+    eraseFromCoveredFrontier(tile);
+    return {FLAG, tile.first - 1, tile.second - 1};
+
+}
+
+
+void MyAI::eraseFromCoveredFrontier(std::pair<int, int> tile) {
+
+    int index = findInVector(coveredFrontier, tile);
+    if (index != -1) {
+        coveredFrontier.erase(coveredFrontier.begin() + index);
     }
 
-    if (x - 1 >= 1 && y + 1 <= rowDimension && effectiveLabels[x - 1][y + 1] > 0) {
-        effectiveLabels[x - 1][y + 1]--;
+}
+
+int& MyAI::hugeLabel(int index) {
+
+    int x = index / labelStride;
+    int y = index % labelStride;
+    if (x < 1 || x > colDimension || y < 1 || y > rowDimension) {
+        borderLabel = BORDER;
+        return borderLabel;
     }
+    return chunkedLabels.at(x, y);
+
+}
+
 
-    if (y + 1 <= rowDimension && effectiveLabels[x][y + 1] > 0) {
-        effectiveLabels[x][y + 1]--;
+int MyAI::peekHugeLabel(int index) {
+
+    int x = index / labelStride;
+    int y = index % labelStride;
+    if (x < 1 || x > colDimension || y < 1 || y > rowDimension) {
+        return BORDER;
     }
+    return chunkedLabels.get(x, y);
+
+}
+
+
+int MyAI::getNumNeighborCovered(int x, int y) {
+
+    return countLabelsAround(x, y, -2);
 
-    if (x + 1 <= colDimension && y + 1 <= rowDimension && effectiveLabels[x + 1][y + 1] > 0) {
-        effectiveLabels[x + 1][y + 1]--;
+}
+
+
+int MyAI::countLabelsAround(int x, int y, int value) {
+
+    if (hugeBoard) {
+        int index = x * labelStride + y;
+        int count = 0;
+        for (int offset : labelOffset) {
+            count += peekLabel(index + offset) == value;
+        }
+        return count;
+    }
+
+    // The tournament sizes get a constant stride, so the offsets fold into the loads
+    // (16x16 and 16x30 share the 16-row stride)
+    const int* cell = &effectiveLabels[x * labelStride + y];
+
+    switch (labelStride) {
+        case BeginnerGeometry::stride:
+            return countAround<BeginnerGeometry::stride>(cell, value);
+        case ExpertGeometry::stride:
+            return countAround<ExpertGeometry::stride>(cell, value);
+        default:
+            return countAround(cell, labelStride, value);
     }
 
-    if (x - 1 >= 1 && effectiveLabels[x - 1][y] > 0) {
-        effectiveLabels[x - 1][y]--;
+}
+
+
+std::pair<int, int> MyAI::getCoveredNeighbor(int x, int y) {
+
+    std::pair<int, int> safeNeighbor;
+    safeNeighbor.first = 0;
+    safeNeighbor.second = 0;
+
+    int index = x * labelStride + y;
+    for (int offset : labelOffset) {
+        if (peekLabel(index + offset) == -2) {
+            safeNeighbor.first = (index + offset) / labelStride;
+            safeNeighbor.second = (index + offset) % labelStride;
+            break;
+        }
     }
-    
-    if (x + 1 <= colDimension && effectiveLabels[x + 1][y] > 0) {
-        effectiveLabels[x + 1][y]--;
+
+    return safeNeighbor;
+
+}
+
+
+int MyAI::getNumFlagNeighbor(int x, int y) {
+
+    return countLabelsAround(x, y, -3);
+
+}
+
+void MyAI::updateEffectiveLabels(int x, int y) {
+
+    int index = x * labelStride + y;
+    for (int offset : labelOffset) {
+        if (peekLabel(index + offset) > 0) {
+            labelAt(index + offset)--;
+        }
     }
 
 }
@@ -766,9 +1484,9 @@ void MyAI::printPassedAssignments(std::vector<std::bitset<20>> pa) {
 
 void MyAI::printEF() {
 
-    for (std::vector<int> x : effectiveLabels) {
-        for (int effL : x) {
-            std::cout << effL << "\t";
+    for (int x = 1; x <= colDimension; x++) {
+        for (int y = 1; y <= rowDimension; y++) {
+            std::cout << label(x, y) << "\t";
         }
         std::cout << std::endl;
     }
@@ -780,51 +1498,12 @@ std::queue<std::pair<int, int>> MyAI::getAllCoveredNeighbors(int x, int y) {
 
     std::queue<std::pair<int, int>> result;
 
-    if (x - 1 >= 1 && y - 1 >= 1 && effectiveLabels[x - 1][y - 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x - 1, y - 1};
-        result.push(coveredNeighbor);
-        
-    }
-    
-    if (y - 1 >= 1 && effectiveLabels[x][y - 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x, y - 1};
-        result.push(coveredNeighbor);
-        
-    }
-    
-    if (x + 1 <= colDimension && y - 1 >= 1 && effectiveLabels[x + 1][y - 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x + 1, y - 1};
-        result.push(coveredNeighbor);
-
-    }
-    
-    if (x - 1 >= 1 && y + 1 <= rowDimension && effectiveLabels[x - 1][y + 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x - 1, y + 1};
-        result.push(coveredNeighbor);
-
-    }
-    
-    if (y + 1 <= rowDimension && effectiveLabels[x][y + 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x, y + 1};
-        result.push(coveredNeighbor);
-
-    }
-    
-    if (x + 1 <= colDimension && y + 1 <= rowDimension && effectiveLabels[x + 1][y + 1] == -2) {
-        std::pair<int, int> coveredNeighbor {x + 1, y + 1};
-        result.push(coveredNeighbor);
-
-    }
-    
-    if (x - 1 >= 1 && effectiveLabels[x - 1][y] == -2) {
-        std::pair<int, int> coveredNeighbor {x - 1, y};
-        result.push(coveredNeighbor);
-
-    }
-    
-    if (x + 1 <= colDimension && effectiveLabels[x + 1][y] == -2) {
-        std::pair<int, int> coveredNeighbor {x + 1, y};
-        result.push(coveredNeighbor);
+    int index = x * labelStride + y;
+    for (int offset : labelOffset) {
+        if (peekLabel(index + offset) == -2) {
+            std::pair<int, int> coveredNeighbor {(index + offset) / labelStride, (index + offset) % labelStride};
+            result.push(coveredNeighbor);
+        }
     }
 
     return result;
@@ -836,51 +1515,12 @@ std::set<std::pair<int, int>> MyAI::getAllUncoveredFrontiers(int x, int y) {
 
     std::set<std::pair<int, int>> result;
 
-    if (x - 1 >= 1 && y - 1 >= 1 && effectiveLabels[x - 1][y - 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x - 1, y - 1};
-        result.insert(coveredNeighbor);
-        
-    }
-    
-    if (y - 1 >= 1 && effectiveLabels[x][y - 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x, y - 1};
-        result.insert(coveredNeighbor);
-        
-    }
-    
-    if (x + 1 <= colDimension && y - 1 >= 1 && effectiveLabels[x + 1][y - 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x + 1, y - 1};
-        result.insert(coveredNeighbor);
-
-    }
-    
-    if (x - 1 >= 1 && y + 1 <= rowDimension && effectiveLabels[x - 1][y + 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x - 1, y + 1};
-        result.insert(coveredNeighbor);
-
-    }
-    
-    if (y + 1 <= rowDimension && effectiveLabels[x][y + 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x, y + 1};
-        result.insert(coveredNeighbor);
-
-    }
-    
-    if (x + 1 <= colDimension && y + 1 <= rowDimension && effectiveLabels[x + 1][y + 1] >= 1) {
-        std::pair<int, int> coveredNeighbor {x + 1, y + 1};
-        result.insert(coveredNeighbor);
-
-    }
-    
-    if (x - 1 >= 1 && effectiveLabels[x - 1][y] >= 1) {
-        std::pair<int, int> coveredNeighbor {x - 1, y};
-        result.insert(coveredNeighbor);
-
-    } 
-    
-    if (x + 1 <= colDimension && effectiveLabels[x + 1][y] >= 1) {
-        std::pair<int, int> coveredNeighbor {x + 1, y};
-        result.insert(coveredNeighbor);
+    int index = x * labelStride + y;
+    for (int offset : labelOffset) {
+        if (peekLabel(index + offset) >= 1) {
+            std::pair<int, int> coveredNeighbor {(index + offset) / labelStride, (index + offset) % labelStride};
+            result.insert(coveredNeighbor);
+        }
     }
 
     return result;
@@ -894,7 +1534,7 @@ std::vector<std::pair<int, int>> MyAI::getBoardCoveredTiles() {
 
     for (int i = 1; i <= colDimension; i++) {
         for (int j = 1; j <= rowDimension; j++) {
-            if (effectiveLabels[i][j] == -2) {
+            if (peekLabel(i * labelStride + j) == -2) {
                 std::pair<int, int> p{i, j};
                 result.push_back(p);
             }
@@ -907,14 +1547,25 @@ std::vector<std::pair<int, int>> MyAI::getBoardCoveredTiles() {
 
 
 std::pair<int, int> MyAI::getRandomCoveredTile() {
+    // Listing the covered tiles of a huge board would cost as much as the board: probe first
+    if (hugeBoard) {
+        for (int probe = 0; probe < maxRandomProbes; probe++) {
+            int x = randomInt(colDimension) + 1;
+            int y = randomInt(rowDimension) + 1;
+            if (peekLabel(x * labelStride + y) == -2) {
+                return std::pair<int, int>{x, y};
+            }
+        }
+    }
+
     std::vector<std::pair<int, int>> v = getBoardCoveredTiles();
-    int index = std::rand() % v.size();
+    int index = randomInt(v.size());
     return v[index];
 }
 
 
 std::pair<int, int> MyAI::getRandomCoveredFrontierTile() {
-    int index = std::rand() % coveredFrontier.size();
+    int index = randomInt(coveredFrontier.size());
     return coveredFrontier[index];
 }
 
@@ -21,16 +21,36 @@
 #define MINE_SWEEPER_CPP_SHELL_MYAI_HPP
 
 #include "Agent.hpp"
+#include "Geometry.hpp"
+#include "ChunkedGrid.hpp"
 #include <iostream> // temporary use
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <algorithm>
 #include <queue>
+#include <deque>
 #include <utility>
 #include <bitset>
 #include <cmath>
 #include <stdlib.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <iterator>
+#include <iomanip>
+
+// Decision statistics (make stats) cost nothing unless MYAI_STATS is defined
+#ifdef MYAI_STATS
+#define MYAI_STAT(statement) statement
+#else
+#define MYAI_STAT(statement)
+#endif
 
 using namespace std;
 
@@ -39,9 +59,79 @@ class MyAI : public Agent
 {
 public:
     MyAI ( int _rowDimension, int _colDimension, int _totalMines, int _agentX, int _agentY );
+    ~MyAI ( );
+
+    // Start a new game, keeping the memory of the last one
+    void reset ( int _rowDimension, int _colDimension, int _totalMines, int _agentX, int _agentY ) override;
 
     Action getAction ( int number ) override;
 
+    // Cascade mode: apply every revealed tile, then decide once
+    bool acceptsReveals ( ) const override { return true; }
+    Action getAction ( const std::vector<Reveal>& reveals ) override;
+
+    // Batch mode: a decision plus every move that follows without a new percept
+    bool acceptsBatches ( ) const override { return true; }
+    void getActions ( const std::vector<Reveal>& reveals, std::vector<Action>& actions ) override;
+
+    // Guessed uncovers and likeliest-mine flags of this game
+    int guesses ( ) const override { return guessCount; }
+
+    // Optional solver modes, set once from Main before any world is run
+    static bool speculativeMode;    // solve the predicted next frontier while the World applies the move
+    static bool portfolioMode;      // race several solving strategies on each frontier
+
+    // Portfolio results over every game of the run
+    enum portfolioStrategy { RULE_PROPAGATION, ENUMERATION, SAMPLING, PORTFOLIO_STRATEGIES };
+    static std::atomic<long> portfolioWins[PORTFOLIO_STRATEGIES];
+    static std::atomic<long> portfolioSavedMicros;
+    static void printPortfolioStats(std::ostream& out);
+
+    // Speculation results over every game of the run
+    static std::atomic<long> speculativeSolves;     // predicted frontiers handed to a worker
+    static std::atomic<long> speculativeHits;       // the ones the next call used
+    static void printSpeculationStats(std::ostream& out);
+
+    // Which branch of getAction produced a move
+    enum decisionType {
+        SWEEP_UNCOVER,          // "uncover the rest" sweep
+        SWEEP_FLAG,             // "flag the rest" sweep
+        LEAVE_GAME,
+        ZERO_OPENING,           // neighbors of a 0 percept
+        PQ_SAFE,                // PQ tile with effective label -1
+        PQ_MINE,                // PQ tile with effective label 0
+        UNIQUE_ASSIGNMENT,      // model checking found exactly one assignment
+        CONSISTENT_BIT,         // tile has the same value in every assignment
+        MAX_PROBABILITY_FLAG,   // FLAG the most likely mine
+        RANDOM_FRONTIER,        // getRandomCoveredFrontierTile
+        RANDOM_COVERED,         // getRandomCoveredTile
+        PORTFOLIO_FORCED,       // forced tile from rule propagation
+        PORTFOLIO_SAMPLED_FLAG, // FLAG the most likely mine from sampling
+        DECISION_TYPES
+    };
+
+#ifdef MYAI_STATS
+    // What the moves of one decision type cost
+    struct decisionStats {
+        long moves = 0;
+        long rows = 0;              // truth-table rows enumerated
+        long constraints = 0;       // constraints checked against those rows
+        long frontierTiles = 0;     // covered frontier size, summed over model checks
+        long refreshes = 0;         // PQ refreshes
+        long nanos = 0;             // time spent in getAction
+    };
+
+    decisionStats gameStats[DECISION_TYPES];                // this game
+    decisionStats runStats[DECISION_TYPES];                 // every game of this agent, unlocked
+    static decisionStats corpusStats[DECISION_TYPES];       // every game of the agents already destroyed
+    static std::vector<const MyAI*> liveAgents;             // their runStats join corpusStats at report time
+    static std::mutex corpusStatsLock;                      // guards corpusStats and liveAgents, never taken per move
+
+    static void addDecisionStats(decisionStats* into, const decisionStats* from, int types = DECISION_TYPES);
+    static void printDecisionStats(std::ostream& out, const decisionStats* stats);
+    static void printCorpusStats(std::ostream& out);
+#endif
+
 
     // ======================================================================
     // YOUR CODE BEGINS
@@ -61,6 +151,58 @@ private:
         double probability;
     };
 
+    // A move decided by an earlier analysis that has not been returned yet
+    struct plannedMove {
+        Action_type action;
+        int tileX;
+        int tileY;
+        decisionType decision;
+    };
+
+    // Work done by one enumeration
+    struct solveCost {
+        unsigned long rows = 0;
+        unsigned long constraints = 0;
+    };
+
+    // One uncovered frontier tile: the covered frontier tiles around it must hold exactly 'mines' mines
+    struct frontierConstraint {
+        std::vector<int> coveredIndex;
+        int mines;
+
+        bool operator==(frontierConstraint const& other) const {
+            return mines == other.mines && coveredIndex == other.coveredIndex;
+        }
+    };
+
+    // Everything model checking needs, detached from effectiveLabels so it can be solved on another thread
+    struct frontierSnapshot {
+        std::vector<std::pair<int, int>> covered;
+        std::vector<frontierConstraint> constraints;
+
+        bool operator==(frontierSnapshot const& other) const {
+            return covered == other.covered && constraints == other.constraints;
+        }
+    };
+
+    // What one portfolio strategy concluded about a frontier; indices refer to frontierSnapshot::covered
+    struct frontierVerdict {
+        int strategy = ENUMERATION;
+        bool definitive = false;
+        std::vector<std::bitset<20>> assignments;   // enumeration
+        std::vector<int> mines;                     // rule propagation
+        std::vector<int> safes;                     // rule propagation
+        std::vector<double> mineProbability;        // sampling
+        solveCost cost;                             // enumeration work
+    };
+
+    // A frontier solved in the background for one predicted percept
+    struct speculation {
+        frontierSnapshot frontier;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        std::future<std::vector<std::bitset<20>>> result;
+    };
+
     struct compareNumber {
         bool operator()(usingTile const& t1, usingTile const& t2) {
             return t1.number > t2.number;
@@ -88,20 +230,112 @@ private:
     bool pqUpdate = false;
     bool workOnFrontier = false;
 
-    // Contains the # of safe neighbors of the coordicate tile (x, y)
-    std::vector<vector<int>> effectiveLabels;
+    // Contains the # of safe neighbors of the coordicate tile (x, y), as a padded grid (see Geometry.hpp)
+    static const int BORDER = -9;
+    static const int PENDING = -4;     // batch mode: uncovered, percept not seen yet
+    std::vector<int> effectiveLabels;
+    int labelStride;
+    int labelOffset[8];
+
+    int& label(int x, int y) {
+        return labelAt(x * labelStride + y);
+    }
+
+    // Huge boards (isHugeBoard) keep the same padded indices in a ChunkedGrid: labelAt
+    // allocates the chunk it writes to, peekLabel never does, so scans over the whole
+    // board cost no memory and only chunks around the frontier are ever allocated.
+    bool hugeBoard = false;
+    ChunkedGrid<int> chunkedLabels;
+    int borderLabel;
+
+    int& labelAt(int index) {
+        return hugeBoard ? hugeLabel(index) : effectiveLabels[index];
+    }
+    int peekLabel(int index) {
+        return hugeBoard ? peekHugeLabel(index) : effectiveLabels[index];
+    }
+    int& hugeLabel(int index);
+    int peekHugeLabel(int index);
+
+    // Every label moved off -2 goes through here, so reset() only restores those
+    // (huge boards drop their chunks instead)
+    std::vector<int> touchedLabels;
+    int& touchLabel(int x, int y) {
+        if (hugeBoard != true) {
+            touchedLabels.push_back(x * labelStride + y);
+        }
+        return label(x, y);
+    }
+
     std::priority_queue<usingTile, vector<usingTile>, compareNumber> pq;
 
     // A vector containing no more than 10 covered frontier
     std::vector<std::pair<int, int>> coveredFrontier;
-    std::bitset<20> truthTableRow;
     std::vector<std::bitset<20>> passedAssignments;
-    std::queue<std::pair<int, int>> safeCoveredFrontierTile;
-    std::queue<std::pair<int, int>> mineCoveredFrontierTile;
+
+    // Moves already known to be forced (zero openings, model checking results).
+    // getAction resumes this plan one step per call and only re-analyses once it runs dry.
+    std::deque<plannedMove> plan;
+    // How many steps of the plan target each tile (by label index), so existInPlan is O(1):
+    // a cascade on a huge board can plan a step for most of the tiles it reveals.
+    std::unordered_map<int, int> plannedTiles;
+    void planMove(const plannedMove& step);
+
+    // Pop planned moves until one is still valid and return it; false if the plan is exhausted
+    bool resumePlan(Action& next);
+    // Plan an UNCOVER for every covered neighbor of a zero tile
+    void planOpening(int x, int y, decisionType decision);
+    bool existInPlan(int x, int y);
+
+    // Speculative solving of the next frontier (see speculativeMode)
+    static const int maxSpeculativeOutcomes = 3;
+    static const int minSpeculativeFrontier = 8;
+    std::vector<speculation> speculations;
+
+    void speculateAfter(Action move);
+    void speculate(int x, int y, int number);
+    bool predictFrontier(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue, frontierSnapshot& frontier);
+    bool takeSpeculation(const frontierSnapshot& frontier, std::vector<std::bitset<20>>& assignments);
+    void cancelSpeculations();
+
+    // Record the percept of the uncovered tile (x, y)
+    void applyPercept(int x, int y, int number);
+
+    // "Uncover the rest" / "flag the rest"; false if neither applies
+    bool sweep(Action& next);
+    bool sweepReady();
+
+    // Model checking, split so that the enumeration runs on a self-contained snapshot
+    Action decideAction(int number);
+    void refreshPQ(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue);
+    frontierSnapshot buildFrontier(std::priority_queue<usingTile, vector<usingTile>, compareNumber>& queue);
+    static std::vector<std::bitset<20>> enumerateAssignments(const frontierSnapshot& frontier, const std::atomic<bool>* cancel, solveCost* cost);
+
+    // Portfolio solving (see portfolioMode)
+    static const int maxSamples = 256;
+    frontierVerdict solvePortfolio(const frontierSnapshot& frontier);
+    static frontierVerdict propagateRules(const frontierSnapshot& frontier);
+    static frontierVerdict sampleAssignments(const frontierSnapshot& frontier, unsigned int seed, const std::atomic<bool>* cancel);
+    Action actOnVerdict(const frontierVerdict& verdict);
+
+    // Book-keeping shared by every path that returns an UNCOVER or FLAG
+    Action uncoverTile(std::pair<int, int> tile, decisionType decision);
+    int guessCount;                         // moves of this game from a guessing decision
+    static bool isGuess(decisionType decision);
+    Action flagTile(std::pair<int, int> tile, decisionType decision);
+
+    // Provenance and cost of the move being decided
+    decisionType lastDecision = LEAVE_GAME;
+#ifdef MYAI_STATS
+    decisionStats callCost;
+    void recordDecision();
+#endif
+    void eraseFromCoveredFrontier(std::pair<int, int> tile);
 
     // Return total number of neighboring covered tiles
     int getNumNeighborCovered(int x, int y);
     int getNumFlagNeighbor(int x, int y);
+    int countLabelsAround(int x, int y, int value);
 
     // Return any tile surrounding a number = 0 tile
     std::pair<int, int> getCoveredNeighbor(int x, int y);
@@ -111,6 +345,7 @@ private:
     bool existInQueue(std::queue<std::pair<int, int>> q, std::pair<int, int> p);
     std::vector<std::pair<int, int>> getBoardCoveredTiles();
     std::pair<int, int> getRandomCoveredTile();
+    static const int maxRandomProbes = 64;  // huge boards: random probes before scanning the board
     std::pair<int, int> getRandomCoveredFrontierTile();
 
 
@@ -26,9 +26,11 @@ public:
         colDimension = _colDimension;
     };
 
+    using Agent::getAction;
+
     Action getAction( int number) override
     {
-        return{actions[rand() % 4], rand() % rowDimension, rand() % colDimension};
+        return{actions[randomInt( 4 )], randomInt( rowDimension ), randomInt( colDimension )};
     }
 
 private:
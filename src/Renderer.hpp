@@ -0,0 +1,146 @@
+// ======================================================================
+// FILE:        Renderer.hpp
+//
+// DESCRIPTION: This file contains the renderer behind debug mode (-d) and
+//              the ManualAI display. A frame is formatted into one buffer
+//              allocated up front and goes out in a single write. On an
+//              ANSI terminal only the first frame is drawn in full; later
+//              frames move the cursor to the tiles that changed since the
+//              frame before and redraw those, then the footer.
+//
+// NOTES:       - The full frame is the layout the World always printed:
+//                rows top down, each tile right-aligned in 8 columns.
+//
+//              - Frames are only redrawn in place when stdout is a terminal
+//                (TERM not dumb) whose window holds the whole frame;
+//                otherwise, and when piped, every frame is written in full.
+//
+//              - A tile is one character: '.' covered, '#' flagged, '*'
+//                mine, '0'-'8' its number.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_RENDERER_HPP
+#define MINE_SWEEPER_CPP_SHELL_RENDERER_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+class Renderer
+{
+public:
+    Renderer ( ) : cols( 0 ), rows( 0 ), drawn( false ), ansi( false ) {}
+
+    // Size the buffers for a cols x rows board; the next frame is drawn in full
+    void reset ( int _cols, int _rows )
+    {
+        cols  = _cols;
+        rows  = _rows;
+        drawn = false;
+        // Cursor moves only address the right cells if no line of the frame wraps or scrolls
+        const char* term = std::getenv( "TERM" );
+        struct winsize window;
+        ansi  = isatty( STDOUT_FILENO ) && term && std::strcmp( term, "dumb" ) != 0
+             && ioctl( STDOUT_FILENO, TIOCGWINSZ, &window ) == 0
+             && window.ws_col > 8 * cols + 5 && window.ws_col > 80 && window.ws_row > 2 * rows + 8;
+        next.assign( cols * rows, '.' );
+        shown.assign( cols * rows, '.' );
+
+        // Full frame: header, two lines per row, the axis, then the footer; every
+        // tile changed costs at most one cursor move and its glyph
+        const std::size_t lineLength = 8 * cols + 16;
+        buffer.clear();
+        buffer.reserve( ( 2 * rows + 8 ) * lineLength + cols * rows * 16 + footerReserve );
+    }
+
+    // Tile [c][r] of the next frame, at c * rows + r as on the World's board
+    char* glyphs ( ) { return next.data(); }
+
+    // Format and write the frame: the board from glyphs(), then footer
+    void draw ( const std::string& footer )
+    {
+        buffer.clear();
+        if ( ansi && drawn )
+            changedTiles();
+        else
+            fullFrame();
+        buffer += footer;
+        shown = next;
+        drawn = true;
+
+        // Whatever went through cout so far comes first
+        std::cout.flush();
+        const char* data = buffer.data();
+        std::size_t left = buffer.size();
+        while ( left > 0 )
+        {
+            ssize_t written = write( STDOUT_FILENO, data, left );
+            if ( written <= 0 )
+                break;
+            data += written;
+            left -= written;
+        }
+    }
+
+    static const std::size_t footerReserve = 256;
+
+private:
+    int     cols;
+    int     rows;
+    bool    drawn;                  // a full frame is on screen
+    bool    ansi;                   // stdout is a terminal that takes cursor moves
+    std::vector<char>   next;       // glyphs of the frame being drawn
+    std::vector<char>   shown;      // glyphs of the last frame written
+    std::string         buffer;
+
+    void fullFrame ( )
+    {
+        if ( ansi )
+            buffer += "\x1b[H\x1b[2J";
+        buffer += "---------------- Game Board ------------------\n\n";
+
+        char label[16];
+        for ( int r = rows - 1; r >= 0; --r )
+        {
+            buffer.append( label, std::snprintf( label, sizeof label, "%-4d|", r + 1 ) );
+            for ( int c = 0; c < cols; ++c )
+            {
+                buffer.append( 7, ' ' );
+                buffer += next[c * rows + r];
+            }
+            buffer += "\n\n";
+        }
+
+        buffer += "     ";
+        for ( int c = 0; c < cols; ++c )
+            buffer += "       -";
+        buffer += "\n     ";
+        for ( int c = 0; c < cols; ++c )
+            buffer.append( label, std::snprintf( label, sizeof label, "%8d", c + 1 ) );
+        buffer += '\n';
+    }
+
+    // Cursor moves to the tiles that changed, then to the footer's line, clearing below it
+    // (a ManualAI prompt or the last "Press ENTER")
+    void changedTiles ( )
+    {
+        char move[32];
+        for ( int c = 0; c < cols; ++c )
+            for ( int r = 0; r < rows; ++r )
+            {
+                const int i = c * rows + r;
+                if ( next[i] == shown[i] )
+                    continue;
+                buffer.append( move, std::snprintf( move, sizeof move, "\x1b[%d;%dH", 3 + 2 * ( rows - 1 - r ), 13 + 8 * c ) );
+                buffer += next[i];
+            }
+        buffer.append( move, std::snprintf( move, sizeof move, "\x1b[%d;1H\x1b[J", 5 + 2 * rows ) );
+    }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_RENDERER_HPP
@@ -0,0 +1,173 @@
+// ======================================================================
+// FILE:        TextScanner.hpp
+//
+// DESCRIPTION: This file contains the scanner behind text world files.
+//              The whole file is read into one buffer with a single read
+//              and integers are parsed from it by hand, with the result
+//              and the eof and fail states that operator>> on an
+//              ifstream would give, so loading keeps its exact semantics
+//              without going through iostreams token by token.
+//
+// NOTES:       - Like a stream, the scanner fails for good on the first
+//                bad token; later reads fail and yield 0.
+//
+//              - eof() is set when a number runs up to the end of the
+//                buffer, or when skipping whitespace reaches it.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_TEXTSCANNER_HPP
+#define MINE_SWEEPER_CPP_SHELL_TEXTSCANNER_HPP
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Arena.hpp"
+
+class TextScanner
+{
+public:
+    TextScanner ( const char* text, std::size_t size )
+        : cursor( text ), end( text + size ), atEnd( false ), failed( false ) {}
+
+    // Read path into memory from arena (or into owned, without one); false if it cannot be read
+    static bool readFile ( const std::string& path, Arena* arena, std::string& owned, const char*& text, std::size_t& size )
+    {
+        int fd = open( path.c_str(), O_RDONLY );
+        if ( fd < 0 )
+            return false;
+        struct stat info;
+        bool ok = fstat( fd, &info ) == 0;
+        size = ok ? info.st_size : 0;
+        char* buffer = nullptr;
+        if ( ok && arena )
+            buffer = static_cast<char*>( arena->allocate( size + 1, 1 ) );
+        else if ( ok )
+        {
+            owned.resize( size );
+            buffer = &owned[0];
+        }
+        for ( std::size_t done = 0; ok && done < size; )
+        {
+            ssize_t got = read( fd, buffer + done, size - done );
+            if ( got <= 0 )
+                size = done;
+            else
+                done += got;
+        }
+        close( fd );
+        text = buffer;
+        return ok;
+    }
+
+    bool eof    ( ) const { return atEnd; }
+    bool fail   ( ) const { return failed; }
+
+    // operator>> for an int: optional sign, decimal digits; out of range fails and clamps
+    bool readInt ( int& value )
+    {
+        value = 0;
+        if ( failed )
+            return false;
+        while ( cursor < end && isSpace( *cursor ) )
+            ++cursor;
+        const bool negative = cursor < end && *cursor == '-';
+        if ( cursor < end && ( *cursor == '-' || *cursor == '+' ) )
+            ++cursor;
+        if ( cursor == end || !isDigit( *cursor ) )
+        {
+            atEnd  = cursor == end;
+            failed = true;
+            return false;
+        }
+
+        long long number = 0;
+        bool overflow = false;
+        for ( ; cursor < end && isDigit( *cursor ); ++cursor )
+        {
+            number = number * 10 + ( *cursor - '0' );
+            if ( number > (long long) INT_MAX + 1 )
+            {
+                overflow = true;
+                number   = (long long) INT_MAX + 1;
+            }
+        }
+        atEnd = cursor == end;
+
+        if ( negative )
+            number = -number;
+        if ( overflow || number > INT_MAX || number < INT_MIN )
+        {
+            value  = number < 0 ? INT_MIN : INT_MAX;
+            failed = true;
+            return false;
+        }
+        value = (int) number;
+        return true;
+    }
+
+    // operator>> for a bool without boolalpha: an int that must be 0 or 1
+    bool readBool ( bool& value )
+    {
+        value = false;
+        if ( failed )
+            return false;
+        while ( cursor < end && isSpace( *cursor ) )
+            ++cursor;
+        // The common case, a lone 0 or 1, without the general path
+        if ( end - cursor >= 2 && ( *cursor == '0' || *cursor == '1' ) && isSpace( cursor[1] ) )
+        {
+            value = *cursor == '1';
+            ++cursor;
+            return true;
+        }
+
+        int number;
+        if ( !readInt( number ) )
+            return false;
+        if ( number != 0 && number != 1 )
+        {
+            value  = true;
+            failed = true;
+            return false;
+        }
+        value = number;
+        return true;
+    }
+
+    // Four bools at once, as bits 0-3, when the next 8 characters are exactly "b b b b "
+    // with b 0 or 1 (the layout of world files); false, reading nothing, otherwise
+    bool readFourBools ( unsigned& bits )
+    {
+        if ( failed )
+            return false;
+        while ( cursor < end && isSpace( *cursor ) )
+            ++cursor;
+        if ( end - cursor < 8 )
+            return false;
+        std::uint64_t word;
+        std::memcpy( &word, cursor, 8 );
+        if ( ( word & 0xFF00FF00FF00FF00ULL ) != 0x2000200020002000ULL
+             || ( word & 0x00FE00FE00FE00FEULL ) != 0x0030003000300030ULL )
+            return false;
+        // The low bits of bytes 0, 2, 4 and 6 (little-endian) to bits 0-3
+        word &= 0x0001000100010001ULL;
+        bits = ( word * 0x0001000200040008ULL ) >> 48 & 0xF;
+        cursor += 7;
+        return true;
+    }
+
+private:
+    const char* cursor;
+    const char* end;
+    bool        atEnd;
+    bool        failed;
+
+    static bool isSpace ( char c ) { return c == ' ' || ( c >= '\t' && c <= '\r' ); }
+    static bool isDigit ( char c ) { return c >= '0' && c <= '9'; }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_TEXTSCANNER_HPP
@@ -0,0 +1,148 @@
+// ======================================================================
+// FILE:        Watchdog.hpp
+//
+// DESCRIPTION: This file contains the watchdog behind time budgets
+//              (--move-budget, --world-budget). Every thread that plays
+//              worlds owns a slot; the World stamps the slot when its
+//              game and each of its moves start, and a watchdog thread
+//              raises the slot's stop flag once a move or the whole game
+//              is over budget. The World ends the game as a timeout at
+//              the next move, and agents with long searches poll the
+//              flag to answer with what they have.
+//
+// NOTES:       - Enforcement is cooperative: nothing is interrupted, and
+//                a budget is caught within a few watchdog periods (a
+//                quarter of the smallest budget, 1 to 100 ms).
+//
+//              - Each trip is reported once on stderr with the world id
+//                the runner gave the slot.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_WATCHDOG_HPP
+#define MINE_SWEEPER_CPP_SHELL_WATCHDOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Watchdog
+{
+public:
+    // Budgets in milliseconds, 0 for none; without any budget no thread is started
+    Watchdog ( int slots, long moveBudget, long worldBudget )
+        : moveNanos( moveBudget * 1000000L ), worldNanos( worldBudget * 1000000L ), done( false )
+    {
+        if ( !enabled() )
+            return;
+        for ( int n = 0; n < slots; ++n )
+            slotList.emplace_back( new Slot() );
+        long smallest = moveNanos > 0 && ( worldNanos == 0 || moveNanos < worldNanos ) ? moveNanos : worldNanos;
+        period = std::chrono::nanoseconds( std::min( std::max( smallest / 4, 1000000L ), 100000000L ) );
+        thread = std::thread( [this] ( ) { watch(); } );
+    }
+
+    ~Watchdog ( )
+    {
+        if ( !enabled() )
+            return;
+        {
+            std::lock_guard<std::mutex> guard( lock );
+            done = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    Watchdog ( const Watchdog& ) = delete;
+    Watchdog& operator= ( const Watchdog& ) = delete;
+
+    bool enabled ( ) const { return moveNanos > 0 || worldNanos > 0; }
+
+    static long now ( )
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // One thread's current world
+    class Slot
+    {
+    public:
+        Slot ( ) : stop( false ), world( -1 ), worldStart( 0 ), moveStart( 0 ) {}
+
+        // The World's side
+        void begin ( )
+        {
+            std::lock_guard<std::mutex> guard( lock );
+            worldStart = moveStart = Watchdog::now();
+            stop = false;
+        }
+        void move ( ) { moveStart.store( Watchdog::now(), std::memory_order_relaxed ); }
+        bool stopped ( ) const { return stop.load( std::memory_order_relaxed ); }
+        void end ( )
+        {
+            std::lock_guard<std::mutex> guard( lock );
+            worldStart = 0;
+        }
+
+        // What the agent polls
+        const std::atomic<bool>* flag ( ) const { return &stop; }
+
+    private:
+        friend class Watchdog;
+        std::atomic<bool>   stop;
+        std::atomic<long>   world;          // id given by the runner, for the report
+        long                worldStart;     // 0 while no game is on; under lock
+        std::atomic<long>   moveStart;
+        std::mutex          lock;           // begin and end against a trip of the game before
+    };
+
+    // Slot index for a world with this id; nullptr without budgets
+    Slot* slot ( int index, long world )
+    {
+        if ( !enabled() )
+            return nullptr;
+        slotList[index]->world = world;
+        return slotList[index].get();
+    }
+
+private:
+    const long                          moveNanos;
+    const long                          worldNanos;
+    std::vector<std::unique_ptr<Slot>>  slotList;
+    std::chrono::nanoseconds            period;
+    std::thread                         thread;
+    std::mutex                          lock;
+    std::condition_variable             wake;
+    bool                                done;
+
+    void watch ( )
+    {
+        std::unique_lock<std::mutex> guard( lock );
+        while ( !wake.wait_for( guard, period, [this] ( ) { return done; } ) )
+        {
+            const long time = now();
+            for ( std::unique_ptr<Slot>& slot : slotList )
+            {
+                std::lock_guard<std::mutex> slotGuard( slot->lock );
+                if ( slot->worldStart == 0 || slot->stop )
+                    continue;
+                const bool overWorld = worldNanos > 0 && time - slot->worldStart > worldNanos;
+                const bool overMove  = moveNanos > 0 && time - slot->moveStart.load( std::memory_order_relaxed ) > moveNanos;
+                if ( overWorld || overMove )
+                {
+                    slot->stop = true;
+                    std::cerr << "[WATCHDOG] World " << slot->world << " is over its " << ( overWorld ? "world" : "move" )
+                              << " budget; it ends as a timeout." << std::endl;
+                }
+            }
+        }
+    }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_WATCHDOG_HPP
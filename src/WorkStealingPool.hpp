@@ -0,0 +1,84 @@
+// ======================================================================
+// FILE:        WorkStealingPool.hpp
+//
+// DESCRIPTION: This file contains the thread pool behind parallel folder
+//              runs (-j N). The items are dealt round-robin onto one
+//              queue per worker, in the order given; a worker takes from
+//              the front of its own queue and, once it is empty, steals
+//              from the back of the others, so the expensive items that
+//              come first start first and the cheap ones fill the tail.
+//
+// NOTES:       - Items never spawn items: when every queue is empty the
+//                run is over.
+//
+//              - task( worker, item ) is called concurrently for
+//                different workers; worker is in [0, threads) and lets
+//                the task keep per-thread state without locking.
+// ======================================================================
+
+#ifndef MINE_SWEEPER_CPP_SHELL_WORKSTEALINGPOOL_HPP
+#define MINE_SWEEPER_CPP_SHELL_WORKSTEALINGPOOL_HPP
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+    template <class Task>
+    static void run ( int threads, const std::vector<int>& items, Task task )
+    {
+        std::vector<std::unique_ptr<Queue>> queues;
+        for ( int worker = 0; worker < threads; ++worker )
+            queues.emplace_back( new Queue() );
+        for ( std::size_t n = 0; n < items.size(); ++n )
+            queues[n % threads]->items.push_back( items[n] );
+
+        std::vector<std::thread> workers;
+        for ( int worker = 0; worker < threads; ++worker )
+            workers.emplace_back( [&queues, &task, threads, worker] ( )
+            {
+                int item;
+                while ( take( queues, worker, threads, item ) )
+                    task( worker, item );
+            } );
+        for ( std::thread& worker : workers )
+            worker.join();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex          lock;
+        std::deque<int>     items;
+    };
+
+    // The front of the worker's own queue, else the back of the first other queue with work
+    static bool take ( std::vector<std::unique_ptr<Queue>>& queues, int worker, int threads, int& item )
+    {
+        for ( int n = 0; n < threads; ++n )
+        {
+            Queue& queue = *queues[( worker + n ) % threads];
+            std::lock_guard<std::mutex> guard( queue.lock );
+            if ( queue.items.empty() )
+                continue;
+            if ( n == 0 )
+            {
+                item = queue.items.front();
+                queue.items.pop_front();
+            }
+            else
+            {
+                item = queue.items.back();
+                queue.items.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif //MINE_SWEEPER_CPP_SHELL_WORKSTEALINGPOOL_HPP
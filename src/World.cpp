@@ -14,14 +14,26 @@
 
 using namespace std;
 
+bool World::interactive = true;
+bool World::timeAgent = false;
+
 // ===============================================================
 // =				Constructor and Destructor
 // ===============================================================
 
-World::World(bool _debug, string aiType, string filename)
+World::World(bool _debug, string aiType, string filename, unsigned long seed, bool _headless, bool _cascade, bool _batch, Arena* _arena, Agent* _pooledAgent)
 {
     // Operation Flags
-    debug = _debug;
+    // Headless mode never prints, so it cannot drive the manualAI
+    headless = _headless && aiType != "manualAI";
+    debug = _debug && !headless;
+    cascade = _cascade;
+    batch = _batch;
+    arena = _arena;
+    pooledAgent = _pooledAgent;
+
+    engine.seed( seed );
+    gameSummary.seed = seed;
 
     // World Initialization
     // True for file provided; false for file not provided, board with default size and random feature
@@ -30,33 +42,14 @@ World::World(bool _debug, string aiType, string filename)
 
         // A text file for constructing the board is given.
 
-        // open file
-        ifstream file;
-        file.open(filename);
-
-        file >> rowDimension >> colDimension;
-        // std::cout << "file rowD = " << rowDimension << std::endl;
-        // std::cout << "file colD = " << colDimension << std::endl;
-
-        if (file.fail())
+        // read the whole file in one go; the scanner parses it as ifstream >> would
+        const char* text;
+        std::size_t size;
+        std::string owned;
+        if ( !TextScanner::readFile( filename, arena, owned, text, size ) )
             throw exception();
-
-        // Board is a 2-D array of Tiles in the form [col][row]
-        board = new Tile*[colDimension];
-        for ( int index = 0; index < colDimension; ++index )
-            board[index] = new Tile[rowDimension];
-
-        // The 2 digits on the second row corresponds to the first safe tile that will be uncovered
-        // at the beginning of the game.
-        file >> agentX >> agentY;
-        // std::cout << "file agentX = " << agentX << std::endl;
-        // std::cout << "file agentY = " << agentY << std::endl;
-
-        // UNCOVER the first tile at position [agentX - 1, agentY - 1] <-- index start at 0
-        lastAction = genFirstAxis(--agentX, --agentY);
-        // Assigning mine value to each Tile according to given file and updating neighbor mine count for each Tile
-        addFeatures ( file );
-        file.close();
+        TextScanner file( text, size );
+        loadText( file );
 
     }
     else
@@ -66,9 +59,7 @@ World::World(bool _debug, string aiType, string filename)
         totalMines      = 10;
         colDimension    = 8;
         rowDimension    = 8;
-        board = new Tile*[colDimension];
-        for ( int index = 0; index < colDimension; ++index )
-            board[index] = new Tile[rowDimension];
+        board = newBoard();
 
         lastAction   = genFirstAxis();
         agentX       = lastAction.x;
@@ -77,6 +68,94 @@ World::World(bool _debug, string aiType, string filename)
         addFeatures();
     }
 
+    addAgent( aiType );
+}
+
+World::World(bool _debug, string aiType, TextScanner& text, unsigned long seed, bool _headless, bool _cascade, bool _batch, Arena* _arena, Agent* _pooledAgent)
+{
+    // Operation Flags, as for a file world
+    headless = _headless && aiType != "manualAI";
+    debug = _debug && !headless;
+    cascade = _cascade;
+    batch = _batch;
+    arena = _arena;
+    pooledAgent = _pooledAgent;
+
+    engine.seed( seed );
+    gameSummary.seed = seed;
+
+    loadText( text );
+
+    addAgent( aiType );
+}
+
+World::World(bool _debug, string aiType, const Corpus::Packed& packed, unsigned long seed, bool _headless, bool _cascade, bool _batch, Arena* _arena, Agent* _pooledAgent)
+{
+    // Operation Flags, as for a file world
+    headless = _headless && aiType != "manualAI";
+    debug = _debug && !headless;
+    cascade = _cascade;
+    batch = _batch;
+    arena = _arena;
+    pooledAgent = _pooledAgent;
+
+    engine.seed( seed );
+    gameSummary.seed = seed;
+
+    // The same steps as reading the text file, from the corpus entry and mine map
+    rowDimension = packed.entry->rows;
+    colDimension = packed.entry->cols;
+    board = newBoard();
+    agentX = packed.entry->startX;
+    agentY = packed.entry->startY;
+    lastAction = genFirstAxis(--agentX, --agentY);
+    addFeatures( packed.mines );
+
+    addAgent( aiType );
+}
+
+World::World(bool _debug, string aiType, int _rowDimension, int _colDimension, int mines, unsigned long seed, bool _headless, bool _cascade, bool _batch, Arena* _arena, Agent* _pooledAgent)
+{
+    // Operation Flags, as for a file world
+    headless = _headless && aiType != "manualAI";
+    debug = _debug && !headless;
+    cascade = _cascade;
+    batch = _batch;
+    arena = _arena;
+    pooledAgent = _pooledAgent;
+
+    engine.seed( seed );
+    gameSummary.seed = seed;
+
+    // Generated in memory, same distribution as WorldGenerator.py
+    rowDimension    = _rowDimension;
+    colDimension    = _colDimension;
+    totalMines      = mines;
+    huge            = isHugeBoard( colDimension, rowDimension );
+    if ( huge )
+    {
+        board = nullptr;
+        chunks.assign( colDimension, rowDimension, Tile() );
+    }
+    else
+        board = newBoard();
+
+    // WorldGenerator.py draws the start uniformly over the board
+    startR       = randomInt( rowDimension );
+    startC       = randomInt( colDimension );
+    agentX       = startC;
+    agentY       = startR;
+
+    addMine();
+    addMineCount();
+    lastAction   = genFirstAxis( startC, startR );
+
+    addAgent( aiType );
+}
+
+void World::addAgent( string aiType )
+// Scoring and agent setup shared by every constructor, once the board is ready
+{
     maxMoves = rowDimension * colDimension * 2;
 
     // For scoring purpose
@@ -96,27 +175,106 @@ World::World(bool _debug, string aiType, string filename)
             break;
     }
 
+    gameSummary.rows  = rowDimension;
+    gameSummary.cols  = colDimension;
+    gameSummary.mines = totalMines;
+
     // Agent Initialization
     score      = 0;
     coveredTiles = rowDimension * colDimension - 1; // Exclude first UNCOVERED Tile
     flagLeft   = totalMines;
 
     if (aiType == "randomAI")
-        agent = new RandomAI( rowDimension, colDimension, totalMines, agentX, agentY );
+    {
+        agent = newAgent<RandomAI>();
+        agentKind = RANDOM_AI;
+    }
 
     else if (aiType == "manualAI")
-        agent = new ManualAI( rowDimension, colDimension, totalMines, agentX, agentY );
+    {
+        agent = newAgent<ManualAI>();
+        agentKind = MANUAL_AI;
+    }
 
     else
-        agent = new MyAI( rowDimension, colDimension, totalMines, agentX, agentY );
+    {
+        agent = newAgent<MyAI>();
+        agentKind = MY_AI;
+    }
+
+    display = debug || agentKind == MANUAL_AI;
+    if ( display )
+    {
+        renderer.reset( colDimension, rowDimension );
+        footer.reserve( Renderer::footerReserve );
+    }
+
+    // Drawn after the layout, so the layout only depends on the seed
+    agent->seed( engine() );
+    agent->watch( nullptr );
+
+    // Cascade and batches only for agents that read the reveal list; the first
+    // percept is then the start tile, with its zero region already opened in cascade
+    cascade = cascade && agent->acceptsReveals();
+    batch = batch && agent->acceptsReveals() && agent->acceptsBatches();
+    if ( cascade || batch )
+        revealFrom( agentX, agentY );
 
 }
 
 World::~World() {
-    for ( int index = 0; index < colDimension; ++index )
-        delete [] board[index];
+    // Arena memory is released by the arena's owner, destructors still run here
+    if ( agent != pooledAgent )
+    {
+        if ( arena )
+            agent->~Agent();
+        else
+            delete agent;
+    }
+
+    if ( !arena )
+        delete [] board;
+}
+
+void World::watchWith( Watchdog::Slot* slot )
+{
+    watch = slot;
+    agent->watch( slot ? slot->flag() : nullptr );
+}
+
+Agent* World::makeAgent( string aiType )
+// Sized for the default board; World resets it to the real one
+{
+    if ( aiType == "randomAI" )
+        return new RandomAI( 8, 8, 10, 0, 0 );
+    if ( aiType == "manualAI" )
+        return new ManualAI( 8, 8, 10, 0, 0 );
+    return new MyAI( 8, 8, 10, 0, 0 );
+}
+
+World::Tile* World::newBoard( )
+{
+    const int tiles = colDimension * rowDimension;
+    if ( !arena )
+        return new Tile[tiles]();
 
-    delete [] board;
+    Tile* tilesFromArena = static_cast<Tile*>( arena->allocate( tiles ) );
+    std::fill( tilesFromArena, tilesFromArena + tiles, Tile() );
+    return tilesFromArena;
+}
+
+template <class AgentType>
+AgentType* World::newAgent( )
+{
+    if ( pooledAgent )
+    {
+        // makeAgent gave the pool the type aiType asks for
+        pooledAgent->reset( rowDimension, colDimension, totalMines, agentX, agentY );
+        return static_cast<AgentType*>( pooledAgent );
+    }
+    if ( !arena )
+        return new AgentType( rowDimension, colDimension, totalMines, agentX, agentY );
+    return arena->make<AgentType>( rowDimension, colDimension, totalMines, agentX, agentY );
 }
 
 // ===============================================================
@@ -125,6 +283,17 @@ World::~World() {
 
 int World::run()
 {
+    if ( watch )
+        watch->begin();
+
+    // Headless: the agent type is known, so the loop calls it directly
+    if ( headless )
+    {
+        if ( agentKind == RANDOM_AI )
+            return runHeadless( static_cast<RandomAI*>( agent ) );
+        return runHeadless( static_cast<MyAI*>( agent ) );
+    }
+
     int perceptNumber;
     bool gameOver = false;
     int move = 0;
@@ -132,22 +301,27 @@ int World::run()
     // WHile the game is not over and there are moves left, keep going
     while ( !gameOver && move < maxMoves )
     {
-        if ( debug || dynamic_cast<ManualAI*>(agent))
+        if ( watch )
+        {
+            if ( timedOut() )
+                break;
+            watch->move();
+        }
+
+        if ( display )
         {
-            printWorldInfo();
+            // Pause the game, only if manualAI isn't on
+            // because manualAI pauses for us
+            const bool pause = agentKind != MANUAL_AI && interactive;
+            printWorldInfo( pause );
 
-            if ( !dynamic_cast<ManualAI*>(agent) )
-            {
-                // Pause the game, only if manualAI isn't on
-                // because manualAI pauses for us
-                cout << "Press ENTER to continue..." << endl;
+            if ( pause )
                 cin.ignore( 999, '\n');
-            }
         }
 
         // If most recent action is UNCOVER, Agent now knows # of neighbor mines
         if (lastAction.action == Agent::UNCOVER)
-            perceptNumber = board[agentX][agentY].number;
+            perceptNumber = tileNumber( tileIndex( agentX, agentY ) );
         else
             perceptNumber = -1;
 
@@ -157,7 +331,29 @@ int World::run()
         -- what action should Agent do next?
         -- getAction() takes in # of mines in neighborhood and return action that Agent should take
         */
-        lastAction = agent->getAction( perceptNumber );
+        if ( batch )
+        {
+            batchActions.clear();
+            {
+                AgentTimer timer( gameSummary );
+                agent->getActions( reveals, batchActions );
+            }
+            if ( timedOut() )
+                break;
+            reveals.clear();
+            gameOver = applyBatch( move );
+            continue;
+        }
+        {
+            AgentTimer timer( gameSummary );
+            if ( cascade )
+                lastAction = agent->getAction( reveals );
+            else
+                lastAction = agent->getAction( perceptNumber );
+        }
+        if ( timedOut() )
+            break;
+        reveals.clear();
 
         // Make the move
         // Make change to the Tile according to the action Agent does
@@ -166,6 +362,69 @@ int World::run()
         move++;
     }
 
+    gameSummary.score = score;
+    gameSummary.moves = move;
+    gameSummary.guesses = agent->guesses();
+    if ( watch )
+        watch->end();
+
+    return score;
+}
+
+
+template <class AgentType>
+int World::runHeadless( AgentType* agent )
+// Same game as run(), without the display checks; the qualified call skips virtual dispatch
+{
+    bool gameOver = false;
+    int move = 0;
+
+    while ( !gameOver && move < maxMoves )
+    {
+        if ( watch )
+        {
+            if ( timedOut() )
+                break;
+            watch->move();
+        }
+
+        if ( batch )
+        {
+            batchActions.clear();
+            {
+                AgentTimer timer( gameSummary );
+                agent->AgentType::getActions( reveals, batchActions );
+            }
+            if ( timedOut() )
+                break;
+            reveals.clear();
+            gameOver = applyBatch( move );
+            continue;
+        }
+
+        if ( cascade )
+        {
+            AgentTimer timer( gameSummary );
+            lastAction = agent->AgentType::getAction( reveals );
+        }
+        else
+        {
+            int perceptNumber = lastAction.action == Agent::UNCOVER ? tileNumber( tileIndex( agentX, agentY ) ) : -1;
+            AgentTimer timer( gameSummary );
+            lastAction = agent->AgentType::getAction( perceptNumber );
+        }
+        if ( timedOut() )
+            break;
+        reveals.clear();
+        gameOver = doMove();
+        move++;
+    }
+
+    gameSummary.score = score;
+    gameSummary.moves = move;
+    gameSummary.guesses = agent->AgentType::guesses();
+    if ( watch )
+        watch->end();
     return score;
 }
 
@@ -181,7 +440,34 @@ void World::addFeatures(    )
     addMineCount();
 }
 
-void World::addFeatures( std::ifstream &file )
+void World::loadText( TextScanner &file )
+// Read a text world: dimensions, first move, then the mines row by row
+{
+    file.readInt( rowDimension );
+    file.readInt( colDimension );
+    // std::cout << "file rowD = " << rowDimension << std::endl;
+    // std::cout << "file colD = " << colDimension << std::endl;
+
+    if (file.fail())
+        throw exception();
+
+    // Board is a single array of packed Tiles in the form [col][row]
+    board = newBoard();
+
+    // The 2 digits on the second row corresponds to the first safe tile that will be uncovered
+    // at the beginning of the game.
+    file.readInt( agentX );
+    file.readInt( agentY );
+    // std::cout << "file agentX = " << agentX << std::endl;
+    // std::cout << "file agentY = " << agentY << std::endl;
+
+    // UNCOVER the first tile at position [agentX - 1, agentY - 1] <-- index start at 0
+    lastAction = genFirstAxis(--agentX, --agentY);
+    // Assigning mine value to each Tile according to given file and updating neighbor mine count for each Tile
+    addFeatures ( file );
+}
+
+void World::addFeatures( TextScanner &file )
 // set feature according to the file
 {
 
@@ -195,13 +481,26 @@ void World::addFeatures( std::ifstream &file )
 
         for ( int c = 0; c < colDimension; ++c )
         {
-            file >> mine;
+            // Four tiles per read while the row is laid out as usual
+            unsigned four;
+            if ( c + 4 <= colDimension && file.readFourBools( four ) )
+            {
+                for ( ; four; four &= four - 1 )
+                {
+                    board[tileIndex( c + __builtin_ctz( four ), r )] |= TILE_MINE;
+                    ++totalMines;
+                }
+                c += 3;
+                continue;
+            }
+
+            file.readBool( mine );
 
             if (file.fail())
                 throw exception();
             if (mine)
             {
-                board[c][r].mine = mine;
+                board[tileIndex( c, r )] |= TILE_MINE;
                 ++totalMines;
             }
         }
@@ -210,6 +509,31 @@ void World::addFeatures( std::ifstream &file )
     addMineCount();
 }
 
+void World::addFeatures( const unsigned char* mines )
+// Set the mines of a packed map: bit i is tile i of the board, 8 tiles per byte
+{
+    const int tiles = colDimension * rowDimension;
+    int i = 0;
+    for ( ; i + 8 <= tiles; i += 8 )
+    {
+        if ( !mines[i / 8] )
+            continue;
+        std::uint64_t packed;
+        std::memcpy( &packed, board + i, 8 );
+        packed |= spreadByte( mines[i / 8] );
+        std::memcpy( board + i, &packed, 8 );
+        totalMines += __builtin_popcount( mines[i / 8] );
+    }
+    for ( ; i < tiles; ++i )
+        if ( mines[i / 8] >> i % 8 & 1 )
+        {
+            board[i] |= TILE_MINE;
+            ++totalMines;
+        }
+
+    addMineCount();
+}
+
 Agent::Action World::genFirstAxis(  )
 // Generate random first move axis: in bound, has no mine, no neighbour has mine
 // return agent for first move coordinates info
@@ -221,10 +545,13 @@ Agent::Action World::genFirstAxis(  )
         fc = randomInt( colDimension );
         fr = randomInt( rowDimension );
     }
-    board[fc][fr].uncovered = true;
+    board[tileIndex( fc, fr )] |= TILE_UNCOVERED;
 
-    std::cout << "First X = " << (int) fc << std::endl;
-    std::cout << "First Y = " << (int) fr << std::endl;
+    if ( !headless )
+    {
+        std::cout << "First X = " << (int) fc << std::endl;
+        std::cout << "First Y = " << (int) fr << std::endl;
+    }
 
     return {Agent::UNCOVER, (int) fc , (int )fr};
 }
@@ -232,7 +559,7 @@ Agent::Action World::genFirstAxis(  )
 Agent::Action World::genFirstAxis(int c, int r) {
 
     try{
-        if (!isInBounds(c, r) || board[c][r].mine || board[c][r].number) {
+        if (!isInBounds(c, r) || isMine( tileIndex( c, r ) ) || tileNumber( tileIndex( c, r ) )) {
             std::cout << "first move x = " << c << std::endl;
             std::cout << "first move y = " << r << std::endl;
             throw "[ERROR] First move coordinates are invalid.";
@@ -243,24 +570,36 @@ Agent::Action World::genFirstAxis(int c, int r) {
     }
 
     // change status of Tile at [c][r] to UNCOVERED
-    board[c][r].uncovered = true;
+    tile( tileIndex( c, r ) ) |= TILE_UNCOVERED;
     return {Agent::UNCOVER, c, r};
 }
 
 
 void World::addMine(    )
 // Generate mine: totalMines times, in bound, no mine before -> [mc][mr]mine = true,
-// not adding mine around and on the first move uncover tile
+// not adding mine around and on the first move uncover tile.
+// Partial Fisher-Yates over the tiles outside the 3x3 patch around the first move:
+// the first totalMines picks are a uniformly random subset, exactly what the
+// rejection loop of WorldGenerator.py converges to, in totalMines draws.
 {
-    for (int m = 0; m < totalMines; ++m){
-        int mc = randomInt( colDimension );
-        int mr = randomInt( rowDimension );
-        while ( !isInBounds( mc, mr ) || board[mc][mr].mine || ((agentX - 2 < mc && mc < agentX + 2) && (agentY - 2 < mr && mr < agentY + 2)) )
-        {
-            mc = randomInt( colDimension );
-            mr = randomInt( rowDimension );
-        }
-        board[mc][mr].mine = true;
+    if ( huge )
+    {
+        countChunkMines();
+        return;
+    }
+
+    std::vector<int> candidates;
+    candidates.reserve( colDimension * rowDimension );
+    for ( int c = 0; c < colDimension; ++c )
+        for ( int r = 0; r < rowDimension; ++r )
+            if ( !((agentX - 2 < c && c < agentX + 2) && (agentY - 2 < r && r < agentY + 2)) )
+                candidates.push_back( tileIndex( c, r ) );
+
+    const int size = candidates.size();
+    for ( int m = 0; m < totalMines && m < size; ++m )
+    {
+        std::swap( candidates[m], candidates[m + randomInt( size - m )] );
+        board[candidates[m]] |= TILE_MINE;
     }
 }
 
@@ -268,14 +607,157 @@ void World::addMineCount(   )
 // Generate number of mines around
 // Assign neighbor mine count to each Tile in the board
 {
-    for ( int c = 0; c < colDimension; ++c ){
-        for ( int r = 0; r < rowDimension; ++r ){
-            if (!board[c][r].mine)
-                addNeighbour( c, r );
+    // Huge boards count a chunk's mines when it is laid out
+    if ( huge )
+        return;
+
+    MineCounter counter = { this };
+    withGeometry( colDimension, rowDimension, counter );
+}
+
+template <class Geometry>
+void World::addMineCount( Geometry geometry )
+// Same as addNeighbour for every tile, 64 tiles per word operation: each column's mines are
+// packed into a bitmap (bit r for row r), the 8 neighbours of a whole column are the columns
+// left, here and right shifted by one row either way, and they are summed into four
+// bit-planes (a bit-sliced counter). Tiles go in and out of the bitmaps 8 at a time, one
+// byte per tile in a 64-bit word. The board size is known at compile time for the
+// tournament sizes, where every column is a single word.
+{
+    const int cols  = geometry.colDimension();
+    const int rows  = geometry.rowDimension();
+    const int words = ( rows + 63 ) / 64;
+
+    // Column c at bits[( c + 1 ) * words], with an empty column on each side
+    const int needed = ( cols + 2 ) * words;
+    std::uint64_t local[localMineWords];
+    std::uint64_t* bits = local;
+    if ( needed > localMineWords )
+    {
+        mineBits.assign( needed, 0 );
+        bits = mineBits.data();
+    }
+    else
+        std::fill( local, local + needed, 0 );
+
+    for ( int c = 0; c < cols; ++c )
+    {
+        std::uint64_t* column = bits + ( c + 1 ) * words;
+        const Tile* tiles = board + c * rows;
+        int r = 0;
+        for ( ; r + 8 <= rows; r += 8 )
+            column[r >> 6] |= mineByte( tiles + r ) << ( r & 63 );
+        for ( ; r < rows; ++r )
+            column[r >> 6] |= (std::uint64_t) ( tiles[r] & TILE_MINE ) << ( r & 63 );
+    }
+
+    for ( int c = 0; c < cols; ++c )
+    {
+        const std::uint64_t* left = bits + c * words;
+        Tile* tiles = board + c * rows;
+        for ( int w = 0; w < words; ++w )
+        {
+            std::uint64_t plane[4] = { 0, 0, 0, 0 };
+            for ( int side = 0; side < 3; ++side )
+            {
+                const std::uint64_t* column = left + side * words;
+                const std::uint64_t below = w > 0 ? column[w - 1] >> 63 : 0;
+                const std::uint64_t above = w + 1 < words ? column[w + 1] << 63 : 0;
+                addToPlanes( plane, column[w] << 1 | below );           // row r - 1
+                addToPlanes( plane, column[w] >> 1 | above );           // row r + 1
+                if ( side != 1 )
+                    addToPlanes( plane, column[w] );                    // row r
+            }
+
+            // Mines keep their tile, every other tile gets its number
+            const std::uint64_t mines = left[words + w];
+            const int first = w * 64;
+            const int last  = std::min( rows, first + 64 );
+            int r = first;
+            for ( ; r + 8 <= last; r += 8 )
+            {
+                const int shift = r - first;
+                const std::uint64_t mineLanes = spreadByte( mines >> shift ) * 0xFF;
+                const std::uint64_t numbers = spreadByte( plane[0] >> shift )
+                                            | spreadByte( plane[1] >> shift ) << 1
+                                            | spreadByte( plane[2] >> shift ) << 2
+                                            | spreadByte( plane[3] >> shift ) << 3;
+                std::uint64_t packed;
+                std::memcpy( &packed, tiles + r, 8 );
+                packed = ( packed & ( mineLanes | 0x0F0F0F0F0F0F0F0FULL ) ) | ( numbers << NUMBER_SHIFT & ~mineLanes );
+                std::memcpy( tiles + r, &packed, 8 );
+            }
+            for ( ; r < last; ++r )
+            {
+                const int bit = r - first;
+                if ( mines >> bit & 1 )
+                    continue;
+                const int number = ( plane[0] >> bit & 1 ) | ( plane[1] >> bit & 1 ) << 1
+                                 | ( plane[2] >> bit & 1 ) << 2 | ( plane[3] >> bit & 1 ) << 3;
+                tiles[r] = ( tiles[r] & ~( 0xF << NUMBER_SHIFT ) ) | ( number << NUMBER_SHIFT );
+            }
         }
     }
 }
 
+void World::addToPlanes( std::uint64_t plane[4], std::uint64_t bits )
+// Add a 1-bit count per lane to the 4-bit counts held in plane[0..3] (ripple carry)
+{
+    for ( int p = 0; p < 4 && bits; ++p )
+    {
+        const std::uint64_t carry = plane[p] & bits;
+        plane[p] ^= bits;
+        bits = carry;
+    }
+}
+
+std::uint64_t World::mineByte( const Tile* tiles )
+// The mine bits of 8 consecutive tiles as bits 0-7 (tile k in bit k, little-endian)
+{
+    std::uint64_t packed;
+    std::memcpy( &packed, tiles, 8 );
+    return ( packed & 0x0101010101010101ULL ) * 0x0102040810204080ULL >> 56;
+}
+
+std::uint64_t World::spreadByte( std::uint64_t bits )
+// Bits 0-7 of bits as the low bit of bytes 0-7, the inverse of mineByte
+{
+    // Bits 0-6 land on distinct byte boundaries without carries; bit 7 is moved on its own
+    return ( ( bits & 0x7F ) * 0x0002040810204081ULL & 0x0101010101010101ULL )
+         | ( bits >> 7 & 1 ) << 56;
+}
+
+void World::addMineCountScalar( )
+// The reference path: addNeighbour for every tile that is not a mine
+{
+    for ( int i = 0; i < colDimension * rowDimension; ++i )
+        board[i] &= ~( 0xF << NUMBER_SHIFT );
+    for ( int c = 0; c < colDimension; ++c )
+        for ( int r = 0; r < rowDimension; ++r )
+            if ( !isMine( tileIndex( c, r ) ) )
+                addNeighbour( c, r );
+}
+
+int World::checkMineCounts( int worlds, unsigned long seed )
+// Generate worlds of the three tournament sizes and of sizes spanning several words per
+// column, and count the ones whose numbers differ from addMineCountScalar
+{
+    const int sizes[][3] = { { 8, 8, 10 }, { 16, 16, 40 }, { 16, 30, 99 },
+                             { 5, 70, 60 }, { 130, 9, 200 }, { 200, 150, 6000 } };
+    int mismatches = 0;
+    for ( const int* size : sizes )
+        for ( int n = 0; n < worlds; ++n )
+        {
+            World world( false, "randomAI", size[0], size[1], size[2], seed + n, true );
+            const int tiles = world.colDimension * world.rowDimension;
+            std::vector<Tile> packed( world.board, world.board + tiles );
+            world.addMineCountScalar();
+            if ( !std::equal( packed.begin(), packed.end(), world.board ) )
+                ++mismatches;
+        }
+    return mismatches;
+}
+
 void World::addNeighbour( int c, int r)
 {
     // helper function for addMineCount
@@ -288,21 +770,21 @@ void World::addNeighbour( int c, int r)
     for (int *i : dir) {
         int nc = c + i[0];
         int nr = r + i[1];
-        if ( isInBounds( nc, nr ) && board[nc][nr].mine ){
-            board[c][r].number++;
+        if ( isInBounds( nc, nr ) && isMine( tileIndex( nc, nr ) ) ){
+            board[tileIndex( c, r )] += 1 << NUMBER_SHIFT;
         }
     }
 }
 
 void World::uncoverAll()
 {
+    // Laying out every chunk of a huge board would cost the dense board it avoids
+    if ( huge )
+        return;
 
-    for ( int c = 0; c < colDimension; ++c )
-    {
-        for ( int r = 0; r < rowDimension; ++r )
-            board[c][r].uncovered = true;
-    }
-    if ( debug || dynamic_cast<ManualAI*>(agent) )
+    for ( int i = 0; i < colDimension * rowDimension; ++i )
+        board[i] |= TILE_UNCOVERED;
+    if ( display )
         printWorldInfo();
 }
 
@@ -311,45 +793,50 @@ bool World::doMove()
 {
     agentX       = lastAction.x;
     agentY       = lastAction.y;
+    const int i  = tileIndex( agentX, agentY );
 
     switch ( lastAction.action )
     {
         case Agent::LEAVE:
             if (coveredTiles == totalMines)
                 score += Bonus;
+            gameSummary.outcome = LEFT;
             uncoverAll();
             return true;
         case Agent::UNCOVER:
-            if (board[agentX][agentY].mine)
+            if (isMine( i ))
             {
+                gameSummary.outcome = MINE;
                 uncoverAll();
                 return true;
             }
 
-            else if (!board[agentX][agentY].uncovered)
+            else if (!isUncovered( i ))
             {
-                board[agentX][agentY].uncovered = true;
+                tile( i ) |= TILE_UNCOVERED;
                 --coveredTiles;
             }
 
+            if ( cascade || batch )
+                revealFrom( agentX, agentY );
             break;
         case Agent::FLAG:
             if (flagLeft)
             {
-                board[agentX][agentY].flag = true;
+                tile( i ) |= TILE_FLAG;
                 --flagLeft;
-                if (board[agentX][agentY].mine)
+                if (isMine( i ))
                     ++correctFlags;
                 else
                     --correctFlags;
             }
             break;
         case Agent::UNFLAG:
-            if (board[agentX][agentY].flag)
+            if (isFlagged( i ))
             {
-                board[agentX][agentY].flag = false;
+                tile( i ) &= ~TILE_FLAG;
                 ++flagLeft;
-                if (board[agentX][agentY].mine)
+                if (isMine( i ))
                     --correctFlags;
                 else
                     ++correctFlags;
@@ -360,68 +847,377 @@ bool World::doMove()
     return false;
 }
 
-bool World::isInBounds ( int c, int r )
+// ===============================================================
+// =				Snapshots and Rollouts
+// ===============================================================
+
+void World::reserveSnapshots( int count )
 {
-    return ( 0 <= c && c < colDimension && 0 <= r && r < rowDimension );
+    if ( huge )
+        throw std::runtime_error( "[ERROR] Snapshots are not available on huge boards." );
+
+    freeSnapshots.reserve( snapshotStore.size() + count );
+    for ( int n = 0; n < count; ++n )
+    {
+        snapshotStore.emplace_back( new Snapshot() );
+        snapshotStore.back()->board.resize( colDimension * rowDimension );
+        freeSnapshots.push_back( snapshotStore.back().get() );
+    }
 }
 
-// ===============================================================
-// =				World Printing Functions
-// ===============================================================
+World::Snapshot* World::snapshot( )
+{
+    if ( freeSnapshots.empty() )
+        reserveSnapshots( 1 );
+    Snapshot* state = freeSnapshots.back();
+    freeSnapshots.pop_back();
+
+    std::copy( board, board + colDimension * rowDimension, state->board.begin() );
+    state->coveredTiles = coveredTiles;
+    state->flagLeft     = flagLeft;
+    state->correctFlags = correctFlags;
+    state->score        = score;
+    state->agentX       = agentX;
+    state->agentY       = agentY;
+    state->lastAction   = lastAction;
+    state->gameSummary  = gameSummary;
+    state->reveals      = reveals;
+    return state;
+}
 
-void World::printWorldInfo(     )
+void World::restore( const Snapshot* state )
 {
-    printBoardInfo();
-    printAgentInfo();
+    std::copy( state->board.begin(), state->board.end(), board );
+    coveredTiles = state->coveredTiles;
+    flagLeft     = state->flagLeft;
+    correctFlags = state->correctFlags;
+    score        = state->score;
+    agentX       = state->agentX;
+    agentY       = state->agentY;
+    lastAction   = state->lastAction;
+    gameSummary  = state->gameSummary;
+    reveals      = state->reveals;
 }
 
-void World::printBoardInfo(     )
+void World::discard( Snapshot* state )
+{
+    freeSnapshots.push_back( state );
+}
+
+bool World::sameState( const Snapshot& a, const Snapshot& b )
 {
-    cout << "---------------- Game Board ------------------\n" << endl;
-    for ( int r = rowDimension-1; r >= 0; --r )
+    const Summary& x = a.gameSummary;
+    const Summary& y = b.gameSummary;
+    return a.board == b.board && a.coveredTiles == b.coveredTiles && a.flagLeft == b.flagLeft
+        && a.correctFlags == b.correctFlags && a.score == b.score && a.agentX == b.agentX && a.agentY == b.agentY
+        && a.lastAction.action == b.lastAction.action && a.lastAction.x == b.lastAction.x && a.lastAction.y == b.lastAction.y
+        && x.score == y.score && x.moves == y.moves && x.outcome == y.outcome && x.seed == y.seed && x.rows == y.rows
+        && x.cols == y.cols && x.mines == y.mines && x.guesses == y.guesses && x.agentNanos == y.agentNanos
+        && a.reveals.size() == b.reveals.size()
+        && std::equal( a.reveals.begin(), a.reveals.end(), b.reveals.begin(), []( const Agent::Reveal& p, const Agent::Reveal& q )
+                       { return p.x == q.x && p.y == q.y && p.number == q.number; } );
+}
+
+int World::checkSnapshots( int worlds, unsigned long seed )
+// Snapshot part way into a game, play the World's own agent a few more moves, restore, and
+// count the worlds where restore() did not give the snapshot back, or where a twin World
+// playing the same moves straight through ends somewhere else. Worlds whose game is over
+// before the snapshot, or whose moves change nothing (the flag sweep repeats a flag until
+// the mines are counted), test nothing and are skipped; so is a size none of them tests. The World's engine is only drawn from while it is built (layout,
+// start tile, agent seed), so a game never moves it and the snapshot has none to keep;
+// the agent's own state and random stream are the agent's, hence the twin for a replay.
+{
+    const int sizes[][3] = { { 8, 8, 10 }, { 16, 16, 40 }, { 16, 30, 99 } };
+    int mismatches = 0;
+    for ( const int* size : sizes )
     {
-        printf("%-4d%c",r+1,'|');
-        for ( int c = 0; c < colDimension; ++c )
-            printTileInfo ( c, r );
-        cout << endl << endl;
+        int tested = 0;
+        for ( int n = 0; n < worlds; ++n )
+        {
+            World world( false, "", size[0], size[1], size[2], seed + n, true, n % 2 == 1 );
+            Summary lead = world.rollout( *world.agent, n % 20 );
+            if ( lead.outcome != OUT_OF_MOVES )
+                continue;
+
+            Snapshot* before = world.snapshot();
+            Summary played = world.rollout( *world.agent, 1 + n % 10 );
+            Snapshot* moved = world.snapshot();
+            const bool changed = !sameState( *before, *moved );
+            world.restore( before );
+            Snapshot* after = world.snapshot();
+
+            World twin( false, "", size[0], size[1], size[2], seed + n, true, n % 2 == 1 );
+            twin.rollout( *twin.agent, lead.moves + played.moves );
+            Snapshot* replayed = twin.snapshot();
+
+            if ( changed && ( !sameState( *before, *after ) || !sameState( *moved, *replayed ) ) )
+                ++mismatches;
+            tested += changed;
+            twin.discard( replayed );
+            world.discard( after );
+            world.discard( moved );
+            world.discard( before );
+        }
+        if ( worlds > 0 && tested == 0 )
+            ++mismatches;
+    }
+
+    // Huge boards have no snapshots; asking for one must throw, and something catchable
+    World huge( false, "", 1025, 1025, 100000, seed, true );
+    try
+    {
+        huge.discard( huge.snapshot() );
+        ++mismatches;
     }
+    catch ( const std::runtime_error& ) {}
+    return mismatches;
+}
 
-    cout << "     ";
-    for (int c = 0; c < colDimension; ++c)
-        cout << setw(8) << "-" ;
-    cout << endl << "     ";
-    for (int c = 0; c < colDimension; ++c)
-        cout << setw(8) << c + 1;
-    cout << endl;
+int World::checkSpeculation( int worlds, unsigned long seed )
+// Speculation only computes ahead what the solver would compute anyway, so a game
+// must play out move for move the same with it on
+{
+    const int sizes[][3] = { { 8, 8, 10 }, { 16, 16, 40 }, { 16, 30, 99 } };
+    const bool speculative = MyAI::speculativeMode;
+    int mismatches = 0;
+    for ( const int* size : sizes )
+        for ( int n = 0; n < worlds; ++n )
+        {
+            Summary played[2];
+            for ( int mode = 0; mode < 2; ++mode )
+            {
+                MyAI::speculativeMode = mode == 1;
+                World world( false, "", size[0], size[1], size[2], seed + n, true );
+                world.run();
+                played[mode] = world.summary();
+            }
+            if ( played[0].score != played[1].score || played[0].moves != played[1].moves
+                 || played[0].outcome != played[1].outcome )
+                ++mismatches;
+        }
+    MyAI::speculativeMode = speculative;
+    return mismatches;
 }
 
-void World::printTileInfo( int c, int r )
+World::Summary World::rollout( Agent& agent, int moves )
 {
+    // The same dispatch as run(): the reveal list in cascade mode, the number otherwise
+    return rollout( [this, &agent]( int number, const std::vector<Agent::Reveal>& revealed )
+                    { return cascade ? agent.getAction( revealed ) : agent.getAction( number ); }, moves );
+}
 
-    string tileString;
+bool World::applyBatch( int& move )
+// Play the moves of batchActions in order, each one a move, until the game ends or the
+// moves run out; their reveals add up for the next getActions. An empty batch leaves.
+{
+    if ( batchActions.empty() )
+        batchActions.push_back( {Agent::LEAVE, 0, 0} );
 
-    if ( board[c][r].uncovered )
-        if ( board[c][r].mine )
-            tileString.append("*");
-        else
+    for ( const Agent::Action& action : batchActions )
+    {
+        if ( move >= maxMoves )
+            return false;
+        lastAction = action;
+        ++move;
+        if ( doMove() )
+            return true;
+    }
+    return false;
+}
+
+void World::revealFrom( int c, int r )
+// Add the uncovered tile [c][r] to reveals and, in cascade mode, if it is a 0, uncover
+// its whole zero region and the numbered tiles around it. Flagged tiles are left alone.
+{
+    const int start = tileIndex( c, r );
+    reveals.push_back( {c, r, tileNumber( start )} );
+    if ( !cascade || tileNumber( start ) != 0 )
+        return;
+
+    int dir[8][2] = { {-1, 1}, {-1, 0}, {-1 , -1},
+                      {0, 1},          {0, -1},
+                      {1, 1}, {1, 0}, {1, -1} };
+
+    cascadeStack.clear();
+    cascadeStack.push_back( start );
+    while ( !cascadeStack.empty() )
+    {
+        const int zero = cascadeStack.back();
+        cascadeStack.pop_back();
+
+        for (int *d : dir) {
+            int nc = zero / rowDimension + d[0];
+            int nr = zero % rowDimension + d[1];
+            if ( !isInBounds( nc, nr ) )
+                continue;
+            const int n = tileIndex( nc, nr );
+            if ( isUncovered( n ) || isFlagged( n ) )
+                continue;
+
+            tile( n ) |= TILE_UNCOVERED;
+            --coveredTiles;
+            reveals.push_back( {nc, nr, tileNumber( n )} );
+            if ( tileNumber( n ) == 0 )
+                cascadeStack.push_back( n );
+        }
+    }
+}
+
+// ===============================================================
+// =				Huge Boards
+// ===============================================================
+
+void World::countChunkMines( )
+// Split totalMines over the chunks with the exact distribution of a uniform layout: walk
+// the tiles outside the start patch chunk by chunk, each a mine with probability (mines
+// left) / (tiles left), and keep only the count per chunk. One draw per tile, no storage.
+{
+    const int side       = ChunkedGrid<Tile>::side;
+    const int chunkCols  = chunks.columnsOfChunks();
+    const int chunkRows  = chunks.rowsOfChunks();
+
+    layoutSeed = engine();
+    chunkMines.assign( chunkCols * chunkRows, 0 );
+
+    std::uint64_t minesLeft = totalMines;
+    std::uint64_t patch     = ( std::min( startC + 1, colDimension - 1 ) - std::max( startC - 1, 0 ) + 1 )
+                            * ( std::min( startR + 1, rowDimension - 1 ) - std::max( startR - 1, 0 ) + 1 );
+    std::uint64_t tilesLeft = (std::uint64_t) colDimension * rowDimension - patch;
+    for ( int cx = 0; cx < chunkCols; ++cx )
+        for ( int cy = 0; cy < chunkRows && minesLeft > 0; ++cy )
+        {
+            int& mines = chunkMines[cx * chunkRows + cy];
+            const int lastC = std::min( colDimension, ( cx + 1 ) * side );
+            const int lastR = std::min( rowDimension, ( cy + 1 ) * side );
+            for ( int c = cx * side; c < lastC; ++c )
+                for ( int r = cy * side; r < lastR; ++r )
+                {
+                    if ( inStartPatch( c, r ) )
+                        continue;
+                    // engine() * tilesLeft >> 32 is uniform over [0, tilesLeft) to within 2^-32
+                    if ( ( (std::uint64_t) engine() * tilesLeft >> 32 ) < minesLeft )
+                    {
+                        ++mines;
+                        --minesLeft;
+                    }
+                    --tilesLeft;
+                }
+        }
+}
+
+void World::chunkMineCells( int cx, int cy ) const
+// Partial Fisher-Yates, as addMine, over the tiles of one chunk outside the start patch
+{
+    const int side  = ChunkedGrid<Tile>::side;
+    const int lastC = std::min( colDimension, ( cx + 1 ) * side );
+    const int lastR = std::min( rowDimension, ( cy + 1 ) * side );
+
+    chunkCells.clear();
+    for ( int c = cx * side; c < lastC; ++c )
+        for ( int r = cy * side; r < lastR; ++r )
+            if ( !inStartPatch( c, r ) )
+                chunkCells.push_back( tileIndex( c, r ) );
+
+    std::seed_seq chunkSeed = { (unsigned) layoutSeed, (unsigned) ( layoutSeed >> 32 ), (unsigned) cx, (unsigned) cy };
+    std::mt19937 stream( chunkSeed );
+    const int mines = chunkMines[cx * chunks.rowsOfChunks() + cy];
+    const int size  = chunkCells.size();
+    for ( int m = 0; m < mines; ++m )
+        std::swap( chunkCells[m], chunkCells[m + std::uniform_int_distribution<int>( 0, size - m - 1 )( stream )] );
+    chunkCells.resize( mines );
+}
+
+World::Tile* World::layOutChunk( int cx, int cy ) const
+// Mines of the chunk and of its 8 neighbours into a map with a one tile margin, then
+// the chunk's tiles with their numbers, as addMineCount would have set them
+{
+    const int side = ChunkedGrid<Tile>::side;
+    const int span = side + 2;
+    const int c0   = cx * side - 1;         // map column 0
+    const int r0   = cy * side - 1;
+
+    mineMap.assign( span * span, 0 );
+    for ( int nx = cx - 1; nx <= cx + 1; ++nx )
+        for ( int ny = cy - 1; ny <= cy + 1; ++ny )
         {
-            tileString.append(to_string(board[c][r].number));
+            if ( nx < 0 || ny < 0 || nx >= chunks.columnsOfChunks() || ny >= chunks.rowsOfChunks() )
+                continue;
+            chunkMineCells( nx, ny );
+            for ( int i : chunkCells )
+            {
+                const int mc = i / rowDimension - c0;
+                const int mr = i % rowDimension - r0;
+                if ( 0 <= mc && mc < span && 0 <= mr && mr < span )
+                    mineMap[mc * span + mr] = 1;
+            }
+        }
 
+    Tile* chunk = chunks.create( cx, cy );
+    for ( int c = 1; c <= side; ++c )
+        for ( int r = 1; r <= side; ++r )
+        {
+            const int m = c * span + r;
+            int number = mineMap[m - span - 1] + mineMap[m - span] + mineMap[m - span + 1]
+                       + mineMap[m - 1] + mineMap[m + 1]
+                       + mineMap[m + span - 1] + mineMap[m + span] + mineMap[m + span + 1];
+            chunk[( c - 1 ) * side + r - 1] = mineMap[m] ? TILE_MINE : number << NUMBER_SHIFT;
         }
-    else if ( board[c][r].flag )
-            tileString.append("#");
-    else
-        tileString.append(".");
+    return chunk;
+}
 
-    cout << setw(8) << tileString;
+World::Tile& World::hugeTile( int i ) const
+{
+    const int c = i / rowDimension;
+    const int r = i % rowDimension;
+    const int bits = ChunkedGrid<Tile>::bits;
+
+    Tile* chunk = chunks.find( c >> bits, r >> bits );
+    if ( !chunk )
+        chunk = layOutChunk( c >> bits, r >> bits );
+    return chunk[ChunkedGrid<Tile>::offset( c, r )];
 }
 
-void World::printAgentInfo()
+bool World::isInBounds ( int c, int r )
+{
+    return ( 0 <= c && c < colDimension && 0 <= r && r < rowDimension );
+}
+
+// ===============================================================
+// =				World Printing Functions
+// ===============================================================
+
+void World::printWorldInfo( bool prompt )
+// One frame through the renderer: the board, then the percepts and the prompt as its footer
 {
-    cout << "\n------------------ Percepts ------------------ " << endl;
-    cout << "Tiles Covered: " << coveredTiles;
-    cout << " Flags Left: " << flagLeft << "    ";
+    printBoardInfo();
+    footer.clear();
+    printAgentInfo();
+    if ( prompt )
+        footer += "Press ENTER to continue...\n";
+    renderer.draw( footer );
+}
 
+void World::printBoardInfo(     )
+{
+    char* glyphs = renderer.glyphs();
+    for ( int i = 0; i < colDimension * rowDimension; ++i )
+        glyphs[i] = tileGlyph( i );
+}
+
+char World::tileGlyph( int i ) const
+{
+    if ( isUncovered( i ) )
+        return isMine( i ) ? '*' : '0' + tileNumber( i );
+    if ( isFlagged( i ) )
+        return '#';
+    return '.';
+}
+
+void World::printAgentInfo()
+{
+    char line[64];
+    footer += "\n------------------ Percepts ------------------ \n";
+    footer.append( line, snprintf( line, sizeof line, "Tiles Covered: %d Flags Left: %d    ", coveredTiles, flagLeft ) );
 
     printActionInfo ();
 }
@@ -431,24 +1227,25 @@ void World::printActionInfo()
     switch ( lastAction.action )
     {
         case Agent::UNCOVER:
-            cout << "Last Action: Uncover";
+            footer += "Last Action: Uncover";
             break;
         case Agent::FLAG:
-            cout << "Last Action: Flag";
+            footer += "Last Action: Flag";
             break;
         case Agent::UNFLAG:
-            cout << "Last Action: Unflag";
+            footer += "Last Action: Unflag";
             break;
         case Agent::LEAVE:
-            cout << "Last Action: Leave" << endl;
+            footer += "Last Action: Leave\n";
             break;
 
         default:
-            cout << "Last Action: Invalid" << endl;
+            footer += "Last Action: Invalid\n";
     }
 
+    char tile[48];
     if (lastAction.action != Agent::LEAVE)
-        cout << " on tile " << agentX + 1 << " " << agentY + 1 << endl;
+        footer.append( tile, snprintf( tile, sizeof tile, " on tile %d %d\n", agentX + 1, agentY + 1 ) );
 }
 
 // ===============================================================
@@ -457,7 +1254,7 @@ void World::printActionInfo()
 
 int World::randomInt ( int limit )
 {
-    return rand() % limit;
+    return std::uniform_int_distribution<int>( 0, limit - 1 )( engine );
 }
 
 
@@ -13,34 +13,169 @@
 #ifndef MINE_SWEEPER_CPP_SHELL_BOARD_HPP
 #define MINE_SWEEPER_CPP_SHELL_BOARD_HPP
 
-#include <cstdio>       // rand
 #include <iostream>     // iostream
 #include <iomanip>      // setw
 #include <string>       // string
 #include <fstream>      // file
+#include <random>       // mt19937
+#include <vector>       // vector
+#include <memory>       // unique_ptr
+#include <cstdint>      // uint64_t
+#include <algorithm>    // min, equal
+#include <cstring>      // memcpy
+#include <stdexcept>    // runtime_error
+#include <chrono>       // steady_clock
 #include "Agent.hpp"
 #include "ManualAI.hpp"
 #include "RandomAI.hpp"
 #include "MyAI.hpp"
+#include "Geometry.hpp"
+#include "Arena.hpp"
+#include "ChunkedGrid.hpp"
+#include "Renderer.hpp"
+#include "Corpus.hpp"
+#include "TextScanner.hpp"
+#include "Watchdog.hpp"
 
 class World{
 
 public:
-    World(bool debug, string aiType, string filename);      // Constructor
+    World(bool debug, string aiType, string filename,                          // Constructor
+          unsigned long seed = 0, bool headless = false, bool cascade = false, bool batch = false,
+          Arena* arena = nullptr, Agent* pooledAgent = nullptr);
+    World(bool debug, string aiType, TextScanner& text,                        // Text world already in memory
+          unsigned long seed = 0, bool headless = false, bool cascade = false, bool batch = false,
+          Arena* arena = nullptr, Agent* pooledAgent = nullptr);
+    World(bool debug, string aiType, const Corpus::Packed& packed,             // World of a packed corpus
+          unsigned long seed = 0, bool headless = false, bool cascade = false, bool batch = false,
+          Arena* arena = nullptr, Agent* pooledAgent = nullptr);
+    World(bool debug, string aiType, int rowDimension, int colDimension,       // Generated world, no file
+          int mines, unsigned long seed, bool headless = false, bool cascade = false, bool batch = false,
+          Arena* arena = nullptr, Agent* pooledAgent = nullptr);
     ~World  (  );                                           // Destructor
     int run (  );                                           // Engine function
 
+    // An agent of aiType for a run to pass to every World it builds: each World
+    // reset()s it for its own game instead of constructing one, and never deletes it.
+    static Agent*   makeAgent   ( string aiType );
+
+    // How a game ended
+    enum Outcome
+    {
+        OUT_OF_MOVES,       // maxMoves reached
+        LEFT,               // the agent returned LEAVE
+        MINE,               // the agent uncovered a mine
+        TIMEOUT,            // over its time budget (watchWith)
+    };
+
+    // End-of-game summary, filled by run()
+    struct Summary
+    {
+        int     score   = 0;
+        int     moves   = 0;
+        Outcome outcome = OUT_OF_MOVES;
+        unsigned long seed = 0;     // replays the game (layout and every random move)
+        int     rows    = 0;
+        int     cols    = 0;
+        int     mines   = 0;
+        int     guesses = -1;       // Agent::guesses()
+        long    agentNanos = 0;     // time spent in the agent, with timeAgent on
+    };
+    const Summary&  summary (  ) const { return gameSummary; }
+
+    // Time budgets: run() stamps slot at the start of the game and of every move, and ends
+    // the game as a TIMEOUT once the watchdog stops it. Call before run(); nullptr for none.
+    void            watchWith   ( Watchdog::Slot* slot );
+
+    // Complete game state, for rollouts: restore() puts the World back exactly
+    // where snapshot() took it, without re-reading the file or re-counting mines.
+    struct Snapshot
+    {
+        std::vector<unsigned char>  board;
+        int                         coveredTiles;
+        int                         flagLeft;
+        int                         correctFlags;
+        int                         score;
+        int                         agentX;
+        int                         agentY;
+        Agent::Action               lastAction;
+        Summary                     gameSummary;
+        std::vector<Agent::Reveal>  reveals;        // the pending percept in cascade mode
+    };
+
+    // Snapshots come from a pool owned by the World; once count snapshots have been
+    // reserved, snapshot() and discard() only allocate to grow a snapshot's copy of the
+    // pending reveals (cascade mode). Not available on huge boards: reserveSnapshots and
+    // snapshot() throw std::runtime_error there, so check before starting a rollout.
+    void        reserveSnapshots    ( int count );
+    Snapshot*   snapshot            (   );                      // copy the current state into a pooled snapshot
+    void        restore             ( const Snapshot* state );  // O(board) copy back, the snapshot stays valid
+    void        discard             ( Snapshot* state );        // return the snapshot to the pool
+    static bool sameState           ( const Snapshot& a, const Snapshot& b );
+
+    // Self-check: build worlds of every tournament size (and a few larger ones) from
+    // seed, seed + 1, ... and return how many of them have neighbour counts that differ
+    // from the scalar path (addNeighbour on every tile).
+    static int  checkMineCounts     ( int worlds, unsigned long seed );
+
+    // Self-check: play worlds of every tournament size a few moves in, with and without
+    // cascade, snapshot, play the agent 1 to 10 moves on, restore, and return how many of
+    // the worlds those moves changed did not come back to the snapshot (board, counters,
+    // last action, summary and reveals), or did not match a twin World playing the same
+    // moves straight through. Also checks that a huge board refuses snapshot() with
+    // std::runtime_error.
+    static int  checkSnapshots      ( int worlds, unsigned long seed );
+
+    // Self-check: play MyAI on worlds of every tournament size from seed, seed + 1, ...
+    // once without and once with speculation (-s), and return how many games differ
+    // (score, moves or outcome). MyAI::speculativeHits says whether anything was used.
+    static int  checkSpeculation    ( int worlds, unsigned long seed );
+
+    // With display on (-d), wait for ENTER after every frame; -n turns it off so a
+    // debug trace runs at full speed
+    static bool interactive;
+
+    // Time every agent call into Summary::agentNanos (off by default: two clock reads a move)
+    static bool timeAgent;
+
+    // Play at most moves moves from the current state, asking policy(number, reveals) for
+    // each action with the percept run() would give the agent, and return how that
+    // continuation ended. The World is left at the end of the continuation; restore() a
+    // snapshot to undo it. policy is any callable Agent::Action(int, const
+    // std::vector<Agent::Reveal>&), e.g. a lambda around an Agent whose own state matches
+    // the current state; in cascade mode reveals holds the tiles flooded since its last
+    // call, and number is only the percept of the tile it uncovered.
+    template <class Policy>
+    Summary     rollout             ( Policy policy, int moves );
+    Summary     rollout             ( Agent& agent, int moves );
+
 private:
-    // Tile structure
-    struct Tile{
-        bool mine       = false; // the tile has Bomb or not
-        bool uncovered  = false; // the tile uncovered or not
-        bool flag       = false; // the tile has been flag or not
-        int  number     = 0;     // records number of bombs around
+    // Tile structure: one byte per tile
+    //   bit 0     the tile has Bomb or not
+    //   bit 1     the tile uncovered or not
+    //   bit 2     the tile has been flag or not
+    //   bits 4-7  records number of bombs around
+    typedef unsigned char Tile;
+    enum TileBits
+    {
+        TILE_MINE       = 1,
+        TILE_UNCOVERED  = 2,
+        TILE_FLAG       = 4,
+        NUMBER_SHIFT    = 4,
     };
 
     // Operation Variables
     bool 	debug;			    // If true, displays board info after every move
+    bool    headless;           // If true, run() uses the tight loop: no printing, no RTTI, no virtual call
+    bool    display;            // Board is printed every move (debug or manualAI), decided at construction
+    bool    cascade;            // If true, uncovering a 0 reveals its whole zero region in one move
+    bool    batch;              // If true, the agent submits its moves in batches (getActions)
+    Summary gameSummary;        // Filled at the end of run()
+    std::mt19937 engine;        // The World's random stream; also seeds the agent's
+
+    // The concrete agent type, so the engine never needs dynamic_cast
+    enum AgentKind { MY_AI, RANDOM_AI, MANUAL_AI };
+    AgentKind agentKind;
 
     // Agent Variables
     Agent* 	agent;			    // The agent
@@ -51,39 +186,161 @@ private:
     int     coveredTiles;       // For faster score calculation and
     int     correctFlags = 0;   // checking game-terminating conditions.
     Agent::Action	lastAction;	// The last action the agent made
+    std::vector<Agent::Reveal>  reveals;        // Cascade and batch modes: tiles revealed since the agent last played
+    std::vector<Agent::Action>  batchActions;   // Batch mode: the moves of the current batch
+    std::vector<int>            cascadeStack;   // Cascade mode: zero tiles left to flood
 
     // Board Variables
     int	    colDimension;	    // The number of columns the game board has
     int	    rowDimension;	    // The number of rows the game board has
-    Tile**	board;			    // The game board
+    Tile*	board;			    // The game board, one allocation; tile [c][r] is board[c * rowDimension + r]
     int     totalMines = 0;         // Number of mines the game board has
 
+    // Huge generated boards (isHugeBoard) have no dense board: tiles live in chunks that are
+    // laid out (mines, then numbers) the first time a tile in them is read, so memory follows
+    // the part of the board the agent reaches. Only the mine count of each chunk is drawn
+    // up front; the mines inside a chunk come from a stream seeded by layoutSeed and the
+    // chunk, so a chunk and its neighbours always agree on them.
+    bool                huge = false;
+    mutable ChunkedGrid<Tile>   chunks;
+    std::vector<int>    chunkMines;         // mines per chunk, [cx * rowsOfChunks + cy]
+    unsigned long       layoutSeed;
+    int                 startC;             // the first move, whose 3x3 patch holds no mine
+    int                 startR;
+    mutable std::vector<int>            chunkCells;     // scratch for chunkMineCells
+    mutable std::vector<unsigned char>  mineMap;        // scratch for layOutChunk
+
+    Watchdog::Slot* watch = nullptr;    // time budgets, see watchWith
+    bool            timedOut        (   )                   // over budget: the game ends as a TIMEOUT
+    {
+        if ( !watch || !watch->stopped() )
+            return false;
+        gameSummary.outcome = TIMEOUT;
+        return true;
+    }
+
+    // Memory: board and agent come from the arena when one is given, else from the heap;
+    // a pooled agent is reset instead of constructed
+    Arena*  arena;
+    Agent*  pooledAgent;
+    Tile*           newBoard        (   );                  // zeroed colDimension * rowDimension tiles
+    template <class AgentType>
+    AgentType*      newAgent        (   );
+
     // World Variables
     int maxMoves;               // the limit of how many actions
     int Bonus;                  // Bonus based on difficulty
 
+    // Snapshot pool
+    std::vector<std::unique_ptr<Snapshot>>  snapshotStore;  // every snapshot ever handed out
+    std::vector<Snapshot*>                  freeSnapshots;  // the ones discarded since
+
     // World Management functions
     void 	        addFeatures	    (   );                  // add random features to the board
-    void	        addFeatures ( std::ifstream &file );	// add specified features according the file to the board
+    void            loadText    ( TextScanner &file );      // board, first move and mines from a text world
+    void	        addFeatures ( TextScanner &file );	    // add specified features according the file to the board
+    void            addFeatures ( const unsigned char* mines );     // add the mines of a packed corpus map
     Agent::Action   genFirstAxis    (   );                  // generate first move axis for default board
     Agent::Action   genFirstAxis    ( int c, int r );       // generate first move axis for file input mode
     void 	        addMine 		(   );                  // add mine to game board
+    void            addAgent        ( string aiType );      // scoring and agent setup shared by the constructors
     void            addMineCount    (   );                  // adding mine counter according to neighbour
     void            addNeighbour    ( int c, int r );       // helper function for addMineCount
+    template <class Geometry>
+    void            addMineCount    ( Geometry geometry );  // addMineCount specialised on the board size
+    static void             addToPlanes     ( std::uint64_t plane[4], std::uint64_t bits );
+    static std::uint64_t    mineByte        ( const Tile* tiles );      // mine bits of 8 tiles
+    static std::uint64_t    spreadByte      ( std::uint64_t bits );     // 8 bits to the low bit of 8 bytes
+    void            addMineCountScalar  (   );              // reference path for checkMineCounts
+    static const int            localMineWords = 64;        // bitmaps up to this size stay on the stack
+    std::vector<std::uint64_t>  mineBits;                   // addMineCount bitmaps beyond localMineWords
+
+    // Visitor for withGeometry, forwards to the matching addMineCount instantiation
+    struct MineCounter
+    {
+        World* world;
+        template <class Geometry>
+        void operator() ( Geometry geometry ) { world->addMineCount( geometry ); }
+    };
     void            uncoverAll      (   );                  // reveal all the tile at the end
     bool            doMove          (   );                  // apply agent's action to the board
+    void            revealFrom      ( int c, int r );       // record the tile in reveals, flood it in cascade mode
+    bool            applyBatch      ( int& move );          // batch mode: play batchActions, true if the game ended
+    template <class AgentType>
+    int             runHeadless     ( AgentType* agent );   // engine loop for headless mode
     bool            isInBounds      ( int c, int r );       // check bound
+    int             tileIndex       ( int c, int r ) const { return c * rowDimension + r; }
+    bool            inStartPatch    ( int c, int r ) const { return startC - 2 < c && c < startC + 2 && startR - 2 < r && r < startR + 2; }
 
-    // World printing functions
-    void	        printWorldInfo	(   );
+    // Huge boards
+    void            countChunkMines (   );                              // split totalMines over the chunks
+    void            chunkMineCells  ( int cx, int cy ) const;           // the mines of a chunk, into chunkCells
+    Tile*           layOutChunk     ( int cx, int cy ) const;           // create a chunk with its mines and numbers
+    Tile&           hugeTile        ( int i ) const;
+
+    // Tile accessors on a linear index
+    Tile&           tile            ( int i ) { return huge ? hugeTile( i ) : board[i]; }
+    Tile            tileAt          ( int i ) const { return huge ? hugeTile( i ) : board[i]; }
+    bool            isMine          ( int i ) const { return tileAt( i ) & TILE_MINE; }
+    bool            isUncovered     ( int i ) const { return tileAt( i ) & TILE_UNCOVERED; }
+    bool            isFlagged       ( int i ) const { return tileAt( i ) & TILE_FLAG; }
+    int             tileNumber      ( int i ) const { return tileAt( i ) >> NUMBER_SHIFT; }
+
+    // World printing functions, formatted into the renderer's frame
+    Renderer        renderer;
+    std::string     footer;                                 // percepts and prompt under the board
+    void	        printWorldInfo	( bool prompt = false );
     void            printBoardInfo  (   );
-    void            printTileInfo   ( int c, int r );
+    char            tileGlyph       ( int i ) const;
     void	        printAgentInfo  (   );
     void	        printActionInfo	(   );
 
     // Helper Functions
-    int	            randomInt	( int limit );              // Randomly generate a int in the range [0, limit)
+    int	            randomInt	( int limit );              // Randomly generate a int in the range [0, limit) from engine
+
+    // Adds the time of the agent call in its scope to Summary::agentNanos, with timeAgent on
+    class AgentTimer
+    {
+    public:
+        explicit AgentTimer ( Summary& summary ) : nanos( timeAgent ? &summary.agentNanos : nullptr )
+        {
+            if ( nanos )
+                start = std::chrono::steady_clock::now();
+        }
+        ~AgentTimer ( )
+        {
+            if ( nanos )
+                *nanos += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+        }
+    private:
+        long*                                   nanos;
+        std::chrono::steady_clock::time_point   start;
+    };
 
 };
 
+template <class Policy>
+World::Summary World::rollout( Policy policy, int moves )
+{
+    Summary real = gameSummary;
+    gameSummary.outcome = OUT_OF_MOVES;
+
+    bool gameOver = false;
+    int move = 0;
+    while ( !gameOver && move < moves )
+    {
+        int perceptNumber = lastAction.action == Agent::UNCOVER ? tileNumber( tileIndex( agentX, agentY ) ) : -1;
+        lastAction = policy( perceptNumber, reveals );
+        reveals.clear();
+        gameOver = doMove();
+        move++;
+    }
+
+    Summary result = gameSummary;
+    result.score = score;
+    result.moves = move;
+    gameSummary = real;
+    return result;
+}
+
 #endif //MINE_SWEEPER_CPP_SHELL_BOARD_HPP